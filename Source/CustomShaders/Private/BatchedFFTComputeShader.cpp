@@ -0,0 +1,4 @@
+#include "BatchedFFTComputeShader.h"
+
+
+IMPLEMENT_GLOBAL_SHADER(FBatchedFFTComputeShader, "/CustomShaders/BatchedFFTComputeShader.usf", "MainComputeShader", SF_Compute);
\ No newline at end of file
@@ -0,0 +1,4 @@
+#include "BatchedFourierComponentsComputeShader.h"
+
+
+IMPLEMENT_GLOBAL_SHADER(FBatchedFourierComponentsComputeShader, "/CustomShaders/BatchedFourierComponentsComputeShader.usf", "MainComputeShader", SF_Compute);
\ No newline at end of file
@@ -0,0 +1,4 @@
+#include "BatchedInversionComputeShader.h"
+
+
+IMPLEMENT_GLOBAL_SHADER(FBatchedInversionComputeShader, "/CustomShaders/BatchedInversionComputeShader.usf", "MainComputeShader", SF_Compute);
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #define LOCTEXT_NAMESPACE "FCustomShadersModule"
 
+DEFINE_LOG_CATEGORY(LogOcean);
+
 void FCustomShadersModule::StartupModule()
 {
     FString shaderDirectory = FPaths::Combine(FPaths::ProjectDir(), TEXT("Shaders/"));
@@ -0,0 +1,4 @@
+#include "DispersionComputeShader.h"
+
+
+IMPLEMENT_GLOBAL_SHADER(FDispersionComputeShader, "/CustomShaders/DispersionComputeShader.usf", "MainComputeShader", SF_Compute);
\ No newline at end of file
@@ -0,0 +1,466 @@
+#include "OceanCPUSimulation.h"
+
+#include "CustomShaders.h"
+#include "OceanVectorMath.h"
+#include "OceanWorkerPool.h"
+#include "HAL/IConsoleManager.h"
+
+
+#define G 9.81f
+
+// Bins per noise / Box-Muller batch in ComputeInitialSpectra, sized for the stack
+#define SPECTRUM_BATCH_SIZE 256
+
+
+OceanCPUSimulation::OceanCPUSimulation(OceanWorkerPool& pool)
+	: mPool(pool)
+{
+	SetSpectrumParameters(mSpectrumParameters);
+}
+
+
+void OceanCPUSimulation::SetSpectrumParameters(const OceanTextureManager::FSpectrumParameters& spectrumParameters)
+{
+	mSpectrumParameters = spectrumParameters;
+
+	const int N = mSpectrumParameters.N;
+	mRowsPerTask = OceanFFT::GetRowsPerTask(N, mPool.GetNumWorkers());
+
+	// First touch by the owning worker so the pages land next to it
+	mPool.InitialiseOwned(mPositiveSpectrum, N * N, N, mRowsPerTask);
+	mPool.InitialiseOwned(mNegativeSpectrum, N * N, N, mRowsPerTask);
+	mPool.InitialiseOwned(mFrequencyHi, N * N, N, mRowsPerTask);
+	mPool.InitialiseOwned(mFrequencyLo, N * N, N, mRowsPerTask);
+	mPool.InitialiseOwned(mUnitWaveVector, N * N, N, mRowsPerTask);
+	
+	for (int axis = 0; axis < 3; axis++)
+	{
+		mPool.InitialiseOwned(mFourierComponents[axis], N * N, N, mRowsPerTask);
+		mPool.InitialiseOwned(mDisplacement[axis], N * N, N, mRowsPerTask);
+	}
+
+	ComputeInitialSpectra();
+}
+
+
+void OceanCPUSimulation::ComputeInitialSpectra()
+{
+	const int N = mSpectrumParameters.N;
+	const float L = mSpectrumParameters.L;
+	const float A = mSpectrumParameters.A;
+	const float windLength = (mSpectrumParameters.WindSpeed * mSpectrumParameters.WindSpeed) / G;
+	const FVector2f wind = mSpectrumParameters.WindDirection.GetSafeNormal();
+	const float damping = FMath::Square(L / 2000.0f);
+
+	mPool.ParallelFor(FMath::DivideAndRoundUp(N, mRowsPerTask), [&](int task)
+	{
+		const int firstRow = task * mRowsPerTask;
+		const int lastRow = FMath::Min(firstRow + mRowsPerTask, N);
+
+		float noise[4][SPECTRUM_BATCH_SIZE];
+		FOceanComplex gauss[2][SPECTRUM_BATCH_SIZE];
+		
+		for (int y = firstRow; y < lastRow; y++)
+		{
+			for (int x = 0; x < N; x++)
+			{
+				const int index = y * N + x;
+				const int batchIndex = x % SPECTRUM_BATCH_SIZE;
+
+				// Same noise lookups as the GPU: (x, y), (x + 512, y), (x, y + 512), (x + 512, y + 512)
+				if (batchIndex == 0)
+				{
+					const int batchSize = FMath::Min(N - x, SPECTRUM_BATCH_SIZE);
+					OceanVectorMath::NoiseRow(x, y, noise[0], batchSize);
+					OceanVectorMath::NoiseRow(x + 512.0f, y, noise[1], batchSize);
+					OceanVectorMath::NoiseRow(x, y + 512.0f, noise[2], batchSize);
+					OceanVectorMath::NoiseRow(x + 512.0f, y + 512.0f, noise[3], batchSize);
+					OceanVectorMath::GaussRandom(noise[0], noise[1], gauss[0], batchSize);
+					OceanVectorMath::GaussRandom(noise[2], noise[3], gauss[1], batchSize);
+				}
+				const FVector2f k = FVector2f(x - N / 2.0f, y - N / 2.0f) * (2.0f * UE_PI / L);
+				
+				const float magnitude = FMath::Max(k.Size(), 0.00001f);
+				const float magnitudeSq = magnitude * magnitude;
+
+				OceanVectorMath::SplitFrequency(FMath::Sqrt(G * magnitude) / (2.0f * UE_PI), mFrequencyHi[index], mFrequencyLo[index]);
+				mUnitWaveVector[index] = k / magnitude;
+
+				// Phillips spectrum, the k = 0 bin has no direction and stays empty
+				float h0k = 0.0f;
+				float h0minusk = 0.0f;
+				
+				if (!k.IsNearlyZero())
+				{
+					const float envelope = (A / (magnitudeSq * magnitudeSq))
+						* FMath::Exp(-1.0f / (magnitudeSq * windLength * windLength))
+						* FMath::Exp(-magnitudeSq * damping);
+					const float alignment = FMath::Pow(FMath::Abs(FVector2f::DotProduct(k / magnitude, wind)), 6.0f);
+
+					// The alignment is symmetric in k, so both halves share it
+					h0k = FMath::Clamp(FMath::Sqrt(envelope * alignment) / UE_SQRT_2, -4000.0f, 4000.0f);
+					h0minusk = h0k;
+				}
+
+				mPositiveSpectrum[index] = gauss[0][batchIndex] * h0k;
+				mNegativeSpectrum[index] = gauss[1][batchIndex] * h0minusk;
+			}
+		}
+	});
+
+	PruneSpectrum();
+}
+
+
+void OceanCPUSimulation::SetPruningThreshold(float threshold)
+{
+	mPruningThreshold = threshold;
+
+	// Pruning drops bins, so they have to be regenerated first
+	ComputeInitialSpectra();
+}
+
+
+void OceanCPUSimulation::PruneSpectrum()
+{
+	const int N = mSpectrumParameters.N;
+	const int numTasks = FMath::DivideAndRoundUp(N, mRowsPerTask);
+
+	mSpectrumBand = OceanFFT::FBand::Full(N);
+
+	if (mPruningThreshold <= 0.0f)
+		return;
+
+	auto energy = [&](int index)
+	{
+		const FOceanComplex& positive = mPositiveSpectrum[index];
+		const FOceanComplex& negative = mNegativeSpectrum[index];
+		return positive.Real * positive.Real + positive.Imag * positive.Imag + negative.Real * negative.Real + negative.Imag * negative.Imag;
+	};
+
+	TArray<float> taskMaxEnergy;
+	taskMaxEnergy.SetNumZeroed(numTasks);
+
+	mPool.ParallelFor(numTasks, [&](int task)
+	{
+		const int firstRow = task * mRowsPerTask;
+		const int lastRow = FMath::Min(firstRow + mRowsPerTask, N);
+
+		for (int index = firstRow * N; index < lastRow * N; index++)
+		{
+			taskMaxEnergy[task] = FMath::Max(taskMaxEnergy[task], energy(index));
+		}
+	});
+
+	float maxEnergy = 0.0f;
+	for (float taskEnergy : taskMaxEnergy)
+	{
+		maxEnergy = FMath::Max(maxEnergy, taskEnergy);
+	}
+	const float threshold = mPruningThreshold * maxEnergy;
+
+	// Columns [first, end) of each row holding kept bins, empty rows have first >= end
+	TArray<int> rowFirstColumn;
+	TArray<int> rowEndColumn;
+	rowFirstColumn.SetNumUninitialized(N);
+	rowEndColumn.SetNumUninitialized(N);
+
+	mPool.ParallelFor(numTasks, [&](int task)
+	{
+		const int firstRow = task * mRowsPerTask;
+		const int lastRow = FMath::Min(firstRow + mRowsPerTask, N);
+
+		for (int y = firstRow; y < lastRow; y++)
+		{
+			rowFirstColumn[y] = N;
+			rowEndColumn[y] = 0;
+
+			for (int x = 0; x < N; x++)
+			{
+				const int index = y * N + x;
+
+				if (energy(index) < threshold || maxEnergy == 0.0f)
+				{
+					mPositiveSpectrum[index] = FOceanComplex();
+					mNegativeSpectrum[index] = FOceanComplex();
+				}
+				else
+				{
+					rowFirstColumn[y] = FMath::Min(rowFirstColumn[y], x);
+					rowEndColumn[y] = x + 1;
+				}
+			}
+		}
+	});
+
+	int firstRow = N, endRow = 0, firstColumn = N, endColumn = 0;
+	for (int y = 0; y < N; y++)
+	{
+		if (rowFirstColumn[y] < rowEndColumn[y])
+		{
+			firstRow = FMath::Min(firstRow, y);
+			endRow = y + 1;
+			firstColumn = FMath::Min(firstColumn, rowFirstColumn[y]);
+			endColumn = FMath::Max(endColumn, rowEndColumn[y]);
+		}
+	}
+
+	mSpectrumBand = endRow > firstRow
+		? OceanFFT::FBand { firstRow, endRow - firstRow, firstColumn, endColumn - firstColumn }
+		: OceanFFT::FBand();
+}
+
+
+void OceanCPUSimulation::ComputeFourierComponents(double time)
+{
+	const int N = mSpectrumParameters.N;
+
+	// The phase is reduced from the split frequency and time like on the GPU, so long uptimes don't lose precision
+	float timeHi, timeLo;
+	OceanTextureManager::SplitTime(time, timeHi, timeLo);
+
+	const OceanFFT::FBand& band = mSpectrumBand;
+
+	mPool.ParallelFor(FMath::DivideAndRoundUp(N, mRowsPerTask), [&](int task)
+	{
+		const int firstRow = task * mRowsPerTask;
+		const int lastRow = FMath::Min(firstRow + mRowsPerTask, N);
+
+		for (int y = firstRow; y < lastRow; y++)
+		{
+			// Bins outside the band were pruned, the transforms expect zeros there
+			const bool inBand = y >= band.FirstRow && y < band.FirstRow + band.NumRows;
+			const int firstColumn = inBand ? band.FirstColumn : N;
+			const int endColumn = inBand ? band.FirstColumn + band.NumColumns : N;
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (mActiveAxes[axis])
+				{
+					FOceanComplex* row = &mFourierComponents[axis][y * N];
+					FMemory::Memzero(row, firstColumn * sizeof(FOceanComplex));
+					FMemory::Memzero(row + endColumn, (N - endColumn) * sizeof(FOceanComplex));
+				}
+			}
+
+			if (!inBand)
+				continue;
+
+			const int first = y * N + firstColumn;
+
+			const OceanVectorMath::FSpectrumBins bins {
+				&mPositiveSpectrum[first], &mNegativeSpectrum[first], &mFrequencyHi[first], &mFrequencyLo[first], &mUnitWaveVector[first]
+			};
+
+			auto output = [&](int axis) { return mActiveAxes[axis] ? &mFourierComponents[axis][first] : nullptr; };
+			OceanVectorMath::EvolveSpectrum(bins, timeHi, timeLo, output(0), output(1), output(2), band.NumColumns);
+		}
+	});
+}
+
+
+void OceanCPUSimulation::Invert(float* const publishedAxes[3])
+{
+	const int N = mSpectrumParameters.N;
+	const float scale = 1.0f / (N * N);
+
+	mPool.ParallelFor(FMath::DivideAndRoundUp(N, mRowsPerTask), [&](int task)
+	{
+		const int firstRow = task * mRowsPerTask;
+		const int lastRow = FMath::Min(firstRow + mRowsPerTask, N);
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (!mActiveAxes[axis])
+				continue;
+			
+			float* published = publishedAxes[axis];
+			
+			for (int y = firstRow; y < lastRow; y++)
+			{
+				for (int x = 0; x < N; x++)
+				{
+					const float sign = ((x + y) & 1) ? -1.0f : 1.0f;
+					const float value = sign * mFourierComponents[axis][y * N + x].Real * scale;
+					mDisplacement[axis][y * N + x] = value;
+					
+					if (published)
+					{
+						published[y * N + x] = value;
+					}
+				}
+			}
+		}
+	});
+}
+
+
+void OceanCPUSimulation::ComputeDisplacement(double time, EOceanOutputs outputs)
+{
+	const int N = mSpectrumParameters.N;
+
+	mFrameArena.Reset();
+	
+	TArray<FOceanComplex*, TInlineAllocator<3>> fields;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const bool active = OceanTextureManager::NeedsDisplacementAxis(outputs, axis);
+		
+		// Skipped axes read as zero, which is also what the height pyramid expects of a flat axis
+		if (!active && mActiveAxes[axis])
+		{
+			FMemory::Memzero(mDisplacement[axis].GetData(), mDisplacement[axis].Num() * sizeof(float));
+		}
+		
+		mActiveAxes[axis] = active;
+		
+		if (active)
+		{
+			fields.Add(mFourierComponents[axis].GetData());
+		}
+	}
+	
+	if (fields.Num() == 0)
+		return;
+	
+	ComputeFourierComponents(time);
+
+	OceanFFT::Inverse2D(fields, N, mSpectrumBand, mPool, &mFrameArena);
+
+	float* publishedAxes[3] = {};
+	if (mPublisher)
+	{
+		uint32 axisMask = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			axisMask |= mActiveAxes[axis] ? 1u << axis : 0u;
+		}
+		mPublisher->BeginFrame(time, N, mSpectrumParameters.L, axisMask, publishedAxes);
+	}
+
+	Invert(publishedAxes);
+
+	if (mPublisher)
+	{
+		mPublisher->EndFrame();
+	}
+
+	if (mHeightPyramidEnabled)
+	{
+		mHeightPyramid.Build(mDisplacement[0], mDisplacement[1], mDisplacement[2], N, mSpectrumParameters.L, mPool);
+	}
+}
+
+
+OceanCPUSimulation::FPruningReport OceanCPUSimulation::MeasurePruning(int N, float threshold, int frames)
+{
+	OceanCPUSimulation full;
+	OceanCPUSimulation pruned;
+	full.mPruningThreshold = 0.0f;
+	pruned.mPruningThreshold = threshold;
+
+	OceanTextureManager::FSpectrumParameters spectrumParameters = full.GetSpectrumParameters();
+	spectrumParameters.N = N;
+	full.SetSpectrumParameters(spectrumParameters);
+	pruned.SetSpectrumParameters(spectrumParameters);
+
+	FPruningReport report {};
+	report.N = N;
+	report.Threshold = threshold;
+	report.Band = pruned.GetSpectrumBand();
+
+	double errorSquares = 0.0;
+	double heightSquares = 0.0;
+
+	// Warm up the arenas and caches once before timing
+	full.ComputeDisplacement(0.0);
+	pruned.ComputeDisplacement(0.0);
+
+	for (int frame = 0; frame < frames; frame++)
+	{
+		// Spread over a few minutes of simulated time so every wave phase is covered
+		const double time = frame * 13.7;
+
+		const double fullStart = FPlatformTime::Seconds();
+		full.ComputeDisplacement(time);
+		const double prunedStart = FPlatformTime::Seconds();
+		pruned.ComputeDisplacement(time);
+		const double prunedEnd = FPlatformTime::Seconds();
+
+		report.FullSeconds += prunedStart - fullStart;
+		report.PrunedSeconds += prunedEnd - prunedStart;
+
+		const TArrayView<const float> fullHeight = full.GetDisplacement(1);
+		const TArrayView<const float> prunedHeight = pruned.GetDisplacement(1);
+
+		for (int i = 0; i < N * N; i++)
+		{
+			const float error = FMath::Abs(prunedHeight[i] - fullHeight[i]);
+			report.MaxHeightError = FMath::Max(report.MaxHeightError, error);
+			errorSquares += error * error;
+			heightSquares += fullHeight[i] * fullHeight[i];
+		}
+	}
+
+	const int samples = FMath::Max(frames, 1) * N * N;
+	report.FullSeconds /= FMath::Max(frames, 1);
+	report.PrunedSeconds /= FMath::Max(frames, 1);
+	report.RmsHeightError = (float)FMath::Sqrt(errorSquares / samples);
+	report.HeightRms = (float)FMath::Sqrt(heightSquares / samples);
+
+	UE_LOG(LogOcean, Log, TEXT("Pruned spectrum N=%d threshold %g: band %d x %d, %.3f ms -> %.3f ms per frame (%.0f%% saved), height error max %.3g m, rms %.3g m against a height rms of %.3g m"),
+		N, threshold, report.Band.NumColumns, report.Band.NumRows, report.FullSeconds * 1000.0, report.PrunedSeconds * 1000.0,
+		(1.0 - report.PrunedSeconds / report.FullSeconds) * 100.0, report.MaxHeightError, report.RmsHeightError, report.HeightRms);
+
+	return report;
+}
+
+
+static FAutoConsoleCommand GOceanMeasurePruningCommand(
+	TEXT("Ocean.CPU.MeasurePruning"),
+	TEXT("Compares CPU simulation frames of an [N] x [N] (default 512) spectrum with and without pruning the bins below [Threshold] (default OceanCPUSimulation::DefaultPruningThreshold) times the strongest bin's energy"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args)
+	{
+		const int N = args.Num() > 0 ? FCString::Atoi(*args[0]) : 512;
+		const float threshold = args.Num() > 1 ? FCString::Atof(*args[1]) : OceanCPUSimulation::DefaultPruningThreshold;
+		OceanCPUSimulation::MeasurePruning(N, threshold);
+	}));
+
+
+static FAutoConsoleCommand GOceanCheckCPUAllocationsCommand(
+	TEXT("Ocean.CPU.CheckAllocations"),
+	TEXT("Runs [Frames] (default 64) CPU simulation frames after a warm-up at a generic and a specialised FFT size, alternating the outputs, and fails if the frame arena touched the heap after the warm-up"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args)
+	{
+		const int frames = args.Num() > 0 ? FMath::Max(FCString::Atoi(*args[0]), 1) : 64;
+
+		// 32 takes the generic FFT with its twiddles in the arena, 256 a specialised one
+		for (int N : { 32, 256 })
+		{
+			OceanCPUSimulation simulation;
+			OceanTextureManager::FSpectrumParameters spectrumParameters = simulation.GetSpectrumParameters();
+			spectrumParameters.N = N;
+			simulation.SetSpectrumParameters(spectrumParameters);
+			simulation.SetHeightPyramidEnabled(true);
+
+			const EOceanOutputs outputs[] { EOceanOutputs::All, EOceanOutputs::Height, EOceanOutputs::Height | EOceanOutputs::Choppiness };
+			const int numOutputs = UE_ARRAY_COUNT(outputs);
+
+			for (int frame = 0; frame < 2; frame++)
+			{
+				simulation.ComputeDisplacement(frame / 60.0);
+			}
+			const OceanFrameArena::FStats warm = simulation.GetFrameArenaStats();
+
+			for (int frame = 0; frame < frames; frame++)
+			{
+				simulation.ComputeDisplacement((frame + 2) / 60.0, outputs[frame % numOutputs]);
+			}
+			const OceanFrameArena::FStats& stats = simulation.GetFrameArenaStats();
+
+			UE_LOG(LogOcean, Display, TEXT("CPU simulation N=%d: %lld heap allocations after warm-up over %d frames, %lld arena allocations, peak frame %lld bytes"),
+				N, stats.HeapAllocations - warm.HeapAllocations, frames, stats.ArenaAllocations - warm.ArenaAllocations, stats.PeakFrameBytes);
+			ensureMsgf(stats.HeapAllocations == warm.HeapAllocations, TEXT("OceanCPUSimulation N=%d allocated %lld frame arena blocks after warm-up"),
+				N, stats.HeapAllocations - warm.HeapAllocations);
+		}
+	}));
@@ -0,0 +1,274 @@
+#include "OceanFFT.h"
+
+#include "CustomShaders.h"
+#include "OceanFixedSizeFFT.h"
+#include "OceanFrameArena.h"
+#include "OceanWorkerPool.h"
+#include "HAL/IConsoleManager.h"
+
+
+// Square tile edge for the blocked transpose, 32 * 32 complex values = 8 KB per tile
+#define TRANSPOSE_TILE_SIZE 32
+
+
+TArray<FOceanComplex> OceanFFT::MakeTwiddles(int N)
+{
+	TArray<FOceanComplex> twiddles;
+	twiddles.SetNumUninitialized(N / 2);
+	MakeTwiddles(N, twiddles);
+
+	return twiddles;
+}
+
+
+void OceanFFT::MakeTwiddles(int N, TArrayView<FOceanComplex> twiddles)
+{
+	for (int k = 0; k < N / 2; k++)
+	{
+		const double angle = 2.0 * UE_DOUBLE_PI * k / N;
+		twiddles[k] = FOceanComplex((float)cos(angle), (float)sin(angle));
+	}
+}
+
+
+void OceanFFT::InverseRow(FOceanComplex* row, int N, const FOceanComplex* twiddles)
+{
+	InverseRowPruned(row, N, twiddles, 0, N);
+}
+
+
+void OceanFFT::InverseRowPruned(FOceanComplex* row, int N, const FOceanComplex* twiddles, int first, int count)
+{
+	if (count <= 0)
+		return;
+
+	// Bit reversal permutation
+	for (int i = 1, j = 0; i < N; i++)
+	{
+		int bit = N >> 1;
+		for (; j & bit; bit >>= 1)
+		{
+			j ^= bit;
+		}
+		j ^= bit;
+
+		if (i < j)
+		{
+			Swap(row[i], row[j]);
+		}
+	}
+
+	const int log2N = FMath::FloorLog2(N);
+
+	for (int span = 1; span < N; span <<= 1)
+	{
+		const int twiddleStride = N / (2 * span);
+
+		auto butterflies = [&](int start)
+		{
+			for (int k = 0; k < span; k++)
+			{
+				const FOceanComplex p = row[start + k];
+				const FOceanComplex q = row[start + k + span] * twiddles[k * twiddleStride];
+
+				row[start + k] = p + q;
+				row[start + k + span] = p - q;
+			}
+		};
+
+		// Only blocks holding a non-zero input, see TOceanFixedSizeFFT::ForEachBlock
+		const int numBlocks = N / (2 * span);
+
+		if (count >= numBlocks)
+		{
+			for (int start = 0; start < N; start += 2 * span)
+			{
+				butterflies(start);
+			}
+		}
+		else
+		{
+			for (int i = first; i < first + count; i++)
+			{
+				butterflies((int)(ReverseBits((uint32)(i & (numBlocks - 1))) >> (32 - log2N)));
+			}
+		}
+	}
+}
+
+
+int OceanFFT::GetRowsPerTask(int N, int numWorkers)
+{
+	const int rowsForL2 = FMath::Max(1, (256 * 1024) / (N * (int)sizeof(FOceanComplex)));
+	const int rowsForBalance = FMath::Max(1, N / (4 * numWorkers));
+
+	return FMath::Min(rowsForL2, rowsForBalance);
+}
+
+
+void OceanFFT::Transpose(TArrayView<FOceanComplex* const> fields, int N, OceanWorkerPool& pool)
+{
+	const int tiles = FMath::DivideAndRoundUp(N, TRANSPOSE_TILE_SIZE);
+
+	// One task per (field, tile row); the task swaps its tiles on and above the diagonal with their mirror
+	pool.ParallelFor(fields.Num() * tiles, [&](int task)
+	{
+		FOceanComplex* field = fields[task / tiles];
+		const int tileRow = task % tiles;
+
+		for (int tileColumn = tileRow; tileColumn < tiles; tileColumn++)
+		{
+			const int rowEnd = FMath::Min((tileRow + 1) * TRANSPOSE_TILE_SIZE, N);
+			const int columnEnd = FMath::Min((tileColumn + 1) * TRANSPOSE_TILE_SIZE, N);
+
+			for (int y = tileRow * TRANSPOSE_TILE_SIZE; y < rowEnd; y++)
+			{
+				const int xStart = tileRow == tileColumn ? y + 1 : tileColumn * TRANSPOSE_TILE_SIZE;
+
+				for (int x = xStart; x < columnEnd; x++)
+				{
+					Swap(field[y * N + x], field[x * N + y]);
+				}
+			}
+		}
+	}, tiles);
+}
+
+
+void OceanFFT::Inverse2D(TArrayView<FOceanComplex* const> fields, int N, OceanWorkerPool& pool, OceanFrameArena* arena)
+{
+	Inverse2D(fields, N, FBand::Full(N), pool, arena);
+}
+
+
+void OceanFFT::Inverse2D(TArrayView<FOceanComplex* const> fields, int N, const FBand& band, OceanWorkerPool& pool, OceanFrameArena* arena)
+{
+	// Common sizes have compile-time tables, only fall back to the generic transform otherwise
+	const OceanFixedSizeFFT::FInverseRowFunction fixedSizeInverseRow = OceanFixedSizeFFT::FindInverseRow(N);
+	const OceanFixedSizeFFT::FInverseRowPrunedFunction fixedSizeInverseRowPruned = OceanFixedSizeFFT::FindInverseRowPruned(N);
+
+	TArray<FOceanComplex> heapTwiddles;
+	TArrayView<FOceanComplex> twiddles;
+	
+	if (!fixedSizeInverseRow)
+	{
+		if (arena)
+		{
+			twiddles = arena->AllocateArray<FOceanComplex>(N / 2);
+		}
+		else
+		{
+			heapTwiddles.SetNumUninitialized(N / 2);
+			twiddles = heapTwiddles;
+		}
+		
+		MakeTwiddles(N, twiddles);
+	}
+	
+	const int rowsPerTask = GetRowsPerTask(N, pool.GetNumWorkers());
+	const int tasksPerField = FMath::DivideAndRoundUp(N, rowsPerTask);
+
+	// Rows [firstRow, lastRow) of every field, non-zero in [first, first + count). The task decomposition is
+	// the same for any band so every row tile is still handled by its owning worker.
+	auto transformRows = [&](int bandFirstRow, int bandLastRow, int first, int count)
+	{
+		pool.ParallelFor(fields.Num() * tasksPerField, [&](int task)
+		{
+			FOceanComplex* field = fields[task / tasksPerField];
+			const int taskFirstRow = (task % tasksPerField) * rowsPerTask;
+			const int firstRow = FMath::Max(taskFirstRow, bandFirstRow);
+			const int lastRow = FMath::Min3(taskFirstRow + rowsPerTask, N, bandLastRow);
+
+			for (int y = firstRow; y < lastRow; y++)
+			{
+				if (count < N && fixedSizeInverseRowPruned)
+				{
+					fixedSizeInverseRowPruned(field + y * N, first, count);
+				}
+				else if (count < N)
+				{
+					InverseRowPruned(field + y * N, N, twiddles.GetData(), first, count);
+				}
+				else if (fixedSizeInverseRow)
+				{
+					fixedSizeInverseRow(field + y * N);
+				}
+				else
+				{
+					InverseRow(field + y * N, N, twiddles.GetData());
+				}
+			}
+		}, tasksPerField);
+	};
+
+	// Rows, then columns as transposed rows so every butterfly works on contiguous memory. Rows outside the band
+	// are zero and stay zero, after the first direction every column is non-zero in the band's rows.
+	transformRows(band.FirstRow, band.FirstRow + band.NumRows, band.FirstColumn, band.NumColumns);
+	Transpose(fields, N, pool);
+	transformRows(0, N, band.FirstRow, band.NumRows);
+	Transpose(fields, N, pool);
+}
+
+
+TArray<OceanFFT::FScalingSample> OceanFFT::MeasureStrongScaling(int N, int maxWorkers, int iterations)
+{
+	TArray<FScalingSample> samples;
+	maxWorkers = FMath::Clamp(maxWorkers, 1, OceanWorkerPool::MaxWorkers);
+
+	for (int workers = 1; ; workers = FMath::Min(workers * 2, maxWorkers))
+	{
+		OceanWorkerPool pool(workers);
+		const int rowsPerTask = GetRowsPerTask(N, workers);
+
+		TArray<FOceanComplex> fieldData[3];
+		for (TArray<FOceanComplex>& field : fieldData)
+		{
+			pool.InitialiseOwned(field, N * N, N, rowsPerTask);
+		}
+		FOceanComplex* fields[] { fieldData[0].GetData(), fieldData[1].GetData(), fieldData[2].GetData() };
+
+		// Warm up the threads and caches once before timing
+		Inverse2D(fields, N, pool);
+
+		const double start = FPlatformTime::Seconds();
+		for (int i = 0; i < iterations; i++)
+		{
+			Inverse2D(fields, N, pool);
+		}
+		const double seconds = (FPlatformTime::Seconds() - start) / iterations;
+
+		FScalingSample sample;
+		sample.Workers = workers;
+		sample.Seconds = seconds;
+		sample.Speedup = samples.IsEmpty() ? 1.0 : samples[0].Seconds / seconds;
+		sample.Efficiency = sample.Speedup / workers;
+		samples.Add(sample);
+
+		UE_LOG(LogOcean, Log, TEXT("OceanFFT N=%d: %2d workers, %.3f ms per 3-axis transform, speedup %.2fx, efficiency %.0f%%"),
+			N, workers, seconds * 1000.0, sample.Speedup, sample.Efficiency * 100.0);
+
+		if (workers == maxWorkers)
+			break;
+	}
+
+	return samples;
+}
+
+
+static FAutoConsoleCommand GOceanFFTScalingCommand(
+	TEXT("Ocean.FFT.MeasureScaling"),
+	TEXT("Logs strong-scaling efficiency of the CPU 2D FFT. Usage: Ocean.FFT.MeasureScaling [N] [MaxWorkers]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args)
+	{
+		const int N = args.Num() > 0 ? FCString::Atoi(*args[0]) : 1024;
+		const int maxWorkers = args.Num() > 1 ? FCString::Atoi(*args[1]) : OceanWorkerPool::QueryPhysicalCores().Num();
+
+		if (!FMath::IsPowerOfTwo(N))
+		{
+			UE_LOG(LogOcean, Warning, TEXT("Ocean.FFT.MeasureScaling: N must be a power of two"));
+			return;
+		}
+		
+		OceanFFT::MeasureStrongScaling(N, maxWorkers);
+	})
+);
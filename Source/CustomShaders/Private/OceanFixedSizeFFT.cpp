@@ -0,0 +1,94 @@
+#include "OceanFixedSizeFFT.h"
+
+
+namespace
+{
+	template <int N>
+	bool BuildButterflyTexture(TArray<FVector4f>& texels)
+	{
+		using FTables = TOceanFFTTables<N>;
+		constexpr int width = FTables::Log2N;
+
+		texels.SetNumUninitialized(width * N);
+
+		for (int y = 0; y < N; y++)
+		{
+			for (int stage = 0; stage < width; stage++)
+			{
+				const int span = 1 << stage;
+				const int k = (y * (N >> (stage + 1))) % N;
+
+				// Only k < N / 2 is tabulated, exp(2 pi i (k + N / 2) / N) = -exp(2 pi i k / N)
+				const FOceanComplex twiddle = k < N / 2 ? FTables::Data.Twiddles[k] : FTables::Data.Twiddles[k - N / 2] * -1.0f;
+				const bool topWing = y % (2 * span) < span;
+
+				int p, q;
+				if (stage == 0)
+				{
+					p = topWing ? FTables::Data.BitReversed[y] : FTables::Data.BitReversed[y - 1];
+					q = topWing ? FTables::Data.BitReversed[y + 1] : FTables::Data.BitReversed[y];
+				}
+				else
+				{
+					p = topWing ? y : y - span;
+					q = topWing ? y + span : y;
+				}
+
+				texels[y * width + stage] = FVector4f(twiddle.Real, twiddle.Imag, p, q);
+			}
+		}
+
+		return true;
+	}
+}
+
+
+#define OCEAN_FOR_EACH_FIXED_FFT_SIZE(Op) Op(64) Op(128) Op(256) Op(512) Op(1024) Op(2048)
+
+
+OceanFixedSizeFFT::FInverseRowFunction OceanFixedSizeFFT::FindInverseRow(int N)
+{
+	switch (N)
+	{
+#define OCEAN_CASE(Size) case Size: return &TOceanFixedSizeFFT<Size>::InverseRow;
+		OCEAN_FOR_EACH_FIXED_FFT_SIZE(OCEAN_CASE)
+#undef OCEAN_CASE
+	default: return nullptr;
+	}
+}
+
+
+OceanFixedSizeFFT::FInverseRowPrunedFunction OceanFixedSizeFFT::FindInverseRowPruned(int N)
+{
+	switch (N)
+	{
+#define OCEAN_CASE(Size) case Size: return &TOceanFixedSizeFFT<Size>::InverseRowPruned;
+		OCEAN_FOR_EACH_FIXED_FFT_SIZE(OCEAN_CASE)
+#undef OCEAN_CASE
+	default: return nullptr;
+	}
+}
+
+
+const uint16* OceanFixedSizeFFT::FindBitReversedIndices(int N)
+{
+	switch (N)
+	{
+#define OCEAN_CASE(Size) case Size: return TOceanFFTTables<Size>::Data.BitReversed;
+		OCEAN_FOR_EACH_FIXED_FFT_SIZE(OCEAN_CASE)
+#undef OCEAN_CASE
+	default: return nullptr;
+	}
+}
+
+
+bool OceanFixedSizeFFT::BuildButterflyTexture(int N, TArray<FVector4f>& texels)
+{
+	switch (N)
+	{
+#define OCEAN_CASE(Size) case Size: return ::BuildButterflyTexture<Size>(texels);
+		OCEAN_FOR_EACH_FIXED_FFT_SIZE(OCEAN_CASE)
+#undef OCEAN_CASE
+	default: return false;
+	}
+}
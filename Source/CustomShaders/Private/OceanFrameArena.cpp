@@ -0,0 +1,86 @@
+#include "OceanFrameArena.h"
+
+
+OceanFrameArena::OceanFrameArena(int64 initialCapacity)
+{
+	AddBlock(initialCapacity);
+}
+
+
+OceanFrameArena::~OceanFrameArena()
+{
+	FreeBlocks();
+}
+
+
+void* OceanFrameArena::Allocate(int64 size, int64 alignment)
+{
+	check(FMath::IsPowerOfTwo(alignment) && alignment <= DefaultAlignment);
+
+	FBlock& block = mBlocks[mNumBlocks - 1];
+	int64 offset = Align(mOffset, alignment);
+
+	if (offset + size > block.Size)
+	{
+		AddBlock(FMath::Max(size + alignment, block.Size * 2));
+		offset = 0;
+	}
+
+	mOffset = offset + size;
+
+	mStats.ArenaAllocations++;
+	mStats.FrameAllocations++;
+	mStats.FrameBytes += size;
+
+	return mBlocks[mNumBlocks - 1].Data + offset;
+}
+
+
+void OceanFrameArena::Reset()
+{
+	mStats.PeakFrameBytes = FMath::Max(mStats.PeakFrameBytes, mStats.FrameBytes);
+
+	// The last frame did not fit, replace the chain with a single block big enough for all of it
+	if (mNumBlocks > 1)
+	{
+		int64 totalSize = 0;
+		for (int i = 0; i < mNumBlocks; i++)
+		{
+			totalSize += mBlocks[i].Size;
+		}
+
+		FreeBlocks();
+		AddBlock(totalSize);
+	}
+
+	mOffset = 0;
+	mStats.FrameAllocations = 0;
+	mStats.FrameBytes = 0;
+}
+
+
+void OceanFrameArena::AddBlock(int64 minimumSize)
+{
+	checkf(mNumBlocks < MaxBlocks, TEXT("OceanFrameArena ran out of blocks"));
+
+	FBlock& block = mBlocks[mNumBlocks++];
+	block.Size = Align(minimumSize, DefaultAlignment);
+	block.Data = static_cast<uint8*>(FMemory::Malloc(block.Size, DefaultAlignment));
+	mOffset = 0;
+
+	mStats.HeapAllocations++;
+	mStats.CapacityBytes += block.Size;
+}
+
+
+void OceanFrameArena::FreeBlocks()
+{
+	for (int i = 0; i < mNumBlocks; i++)
+	{
+		FMemory::Free(mBlocks[i].Data);
+		mStats.HeapFrees++;
+	}
+
+	mNumBlocks = 0;
+	mStats.CapacityBytes = 0;
+}
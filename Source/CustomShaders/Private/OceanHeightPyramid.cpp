@@ -0,0 +1,610 @@
+#include "OceanHeightPyramid.h"
+
+#include "CustomShaders.h"
+#include "OceanCPUSimulation.h"
+#include "OceanFFT.h"
+#include "OceanWorkerPool.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+
+namespace
+{
+	// Fixed-point steps when inverting the horizontal displacement, converges as long as the surface does not fold
+	constexpr int DisplacementInversionSteps = 4;
+
+	// Surface samples along the ray's span over a candidate level 0 cell
+	constexpr int CandidateSamples = 4;
+
+	// Regula falsi steps on a bracketed sample interval
+	constexpr int RefinementSteps = 6;
+
+	// Rays per pool task
+	constexpr int PacketsPerTask = 16;
+	
+	int Wrap(int value, int size)
+	{
+		// size is a power of two
+		return value & (size - 1);
+	}
+
+	int WrapCell(float cell, int size)
+	{
+		// Stays exact for rays far outside the first tile
+		return (int)(cell - FMath::FloorToFloat(cell / size) * size) & (size - 1);
+	}
+}
+
+
+void OceanHeightPyramid::Build(TArrayView<const float> displacementX, TArrayView<const float> height, TArrayView<const float> displacementY, int N, float L, OceanWorkerPool& pool)
+{
+	check(FMath::IsPowerOfTwo(N) && displacementX.Num() == N * N && height.Num() == N * N && displacementY.Num() == N * N);
+
+	mN = N;
+	mL = L;
+	mCellSize = L / N;
+	mRowsPerTask = OceanFFT::GetRowsPerTask(N, pool.GetNumWorkers());
+
+	// Same sizes every frame, so none of these reallocate once warm
+	mDisplacementX.SetNumUninitialized(N * N);
+	mHeight.SetNumUninitialized(N * N);
+	mDisplacementY.SetNumUninitialized(N * N);
+	mScratch.SetNumUninitialized(N * N);
+	mRowMaxDisplacement.SetNumUninitialized(N);
+	
+	mLevels.SetNum(FMath::FloorLog2(N) + 1);
+	for (int level = 0; level < mLevels.Num(); level++)
+	{
+		mLevels[level].SetNumUninitialized(FMath::Square(N >> level));
+	}
+
+	const int numTasks = FMath::DivideAndRoundUp(N, mRowsPerTask);
+
+	// Copy the fields, bound each level 0 cell by its four corners and track the largest horizontal offset
+	pool.ParallelFor(numTasks, [&](int task)
+	{
+		const int firstRow = task * mRowsPerTask;
+		const int lastRow = FMath::Min(firstRow + mRowsPerTask, N);
+
+		FMemory::Memcpy(&mDisplacementX[firstRow * N], &displacementX[firstRow * N], (lastRow - firstRow) * N * sizeof(float));
+		FMemory::Memcpy(&mHeight[firstRow * N], &height[firstRow * N], (lastRow - firstRow) * N * sizeof(float));
+		FMemory::Memcpy(&mDisplacementY[firstRow * N], &displacementY[firstRow * N], (lastRow - firstRow) * N * sizeof(float));
+
+		for (int y = firstRow; y < lastRow; y++)
+		{
+			const float* row = &height[y * N];
+			const float* nextRow = &height[Wrap(y + 1, N) * N];
+			float maxDisplacementSq = 0.0f;
+			
+			for (int x = 0; x < N; x++)
+			{
+				const int nextX = Wrap(x + 1, N);
+				const float a = row[x], b = row[nextX], c = nextRow[x], d = nextRow[nextX];
+				
+				mScratch[y * N + x] = FVector2f(FMath::Min(FMath::Min(a, b), FMath::Min(c, d)), FMath::Max(FMath::Max(a, b), FMath::Max(c, d)));
+				maxDisplacementSq = FMath::Max(maxDisplacementSq, FMath::Square(displacementX[y * N + x]) + FMath::Square(displacementY[y * N + x]));
+			}
+
+			mRowMaxDisplacement[y] = FMath::Sqrt(maxDisplacementSq);
+		}
+	});
+
+	float maxDisplacement = 0.0f;
+	for (int y = 0; y < N; y++)
+	{
+		maxDisplacement = FMath::Max(maxDisplacement, mRowMaxDisplacement[y]);
+	}
+
+	// The surface above a point comes from a sample at most maxDisplacement away
+	Swap(mScratch, mLevels[0]);
+	Dilate(FMath::Min(FMath::CeilToInt(maxDisplacement / mCellSize), N / 2), pool);
+	
+	for (int level = 1; level < mLevels.Num(); level++)
+	{
+		const int size = N >> level;
+		const TArray<FVector2f>& finer = mLevels[level - 1];
+		TArray<FVector2f>& coarser = mLevels[level];
+
+		auto reduceRows = [&](int firstRow, int lastRow)
+		{
+			for (int y = firstRow; y < lastRow; y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					const FVector2f a = finer[(2 * y) * (2 * size) + 2 * x];
+					const FVector2f b = finer[(2 * y) * (2 * size) + 2 * x + 1];
+					const FVector2f c = finer[(2 * y + 1) * (2 * size) + 2 * x];
+					const FVector2f d = finer[(2 * y + 1) * (2 * size) + 2 * x + 1];
+
+					coarser[y * size + x] = FVector2f(
+						FMath::Min(FMath::Min(a.X, b.X), FMath::Min(c.X, d.X)),
+						FMath::Max(FMath::Max(a.Y, b.Y), FMath::Max(c.Y, d.Y)));
+				}
+			}
+		};
+
+		// The upper levels are too small to be worth waking the pool for
+		if (size >= 64)
+		{
+			const int rowsPerTask = FMath::Max(1, mRowsPerTask >> level);
+			pool.ParallelFor(FMath::DivideAndRoundUp(size, rowsPerTask), [&](int task)
+			{
+				reduceRows(task * rowsPerTask, FMath::Min((task + 1) * rowsPerTask, size));
+			});
+		}
+		else
+		{
+			reduceRows(0, size);
+		}
+	}
+}
+
+
+void OceanHeightPyramid::Dilate(int radius, OceanWorkerPool& pool)
+{
+	if (radius <= 0)
+		return;
+	
+	const int N = mN;
+	const int numTasks = FMath::DivideAndRoundUp(N, mRowsPerTask);
+	TArray<FVector2f>& bounds = mLevels[0];
+
+	// Separable min/max filter, rows into scratch and columns back
+	pool.ParallelFor(numTasks, [&](int task)
+	{
+		for (int y = task * mRowsPerTask; y < FMath::Min((task + 1) * mRowsPerTask, N); y++)
+		{
+			for (int x = 0; x < N; x++)
+			{
+				FVector2f range = bounds[y * N + x];
+				for (int offset = 1; offset <= radius; offset++)
+				{
+					const FVector2f left = bounds[y * N + Wrap(x - offset, N)];
+					const FVector2f right = bounds[y * N + Wrap(x + offset, N)];
+					range = FVector2f(FMath::Min(range.X, FMath::Min(left.X, right.X)), FMath::Max(range.Y, FMath::Max(left.Y, right.Y)));
+				}
+				mScratch[y * N + x] = range;
+			}
+		}
+	});
+
+	pool.ParallelFor(numTasks, [&](int task)
+	{
+		for (int y = task * mRowsPerTask; y < FMath::Min((task + 1) * mRowsPerTask, N); y++)
+		{
+			for (int x = 0; x < N; x++)
+			{
+				FVector2f range = mScratch[y * N + x];
+				for (int offset = 1; offset <= radius; offset++)
+				{
+					const FVector2f up = mScratch[Wrap(y - offset, N) * N + x];
+					const FVector2f down = mScratch[Wrap(y + offset, N) * N + x];
+					range = FVector2f(FMath::Min(range.X, FMath::Min(up.X, down.X)), FMath::Max(range.Y, FMath::Max(up.Y, down.Y)));
+				}
+				bounds[y * N + x] = range;
+			}
+		}
+	});
+}
+
+
+FVector2f OceanHeightPyramid::GetBounds(int level, int x, int y) const
+{
+	const int size = mN >> level;
+	return mLevels[level][Wrap(y, size) * size + Wrap(x, size)];
+}
+
+
+float OceanHeightPyramid::SampleField(const TArray<float>& field, float x, float y) const
+{
+	const float floorX = FMath::FloorToFloat(x);
+	const float floorY = FMath::FloorToFloat(y);
+	const float fracX = x - floorX;
+	const float fracY = y - floorY;
+	
+	const int x0 = WrapCell(floorX, mN);
+	const int y0 = WrapCell(floorY, mN);
+	const int x1 = Wrap(x0 + 1, mN);
+	const int y1 = Wrap(y0 + 1, mN);
+
+	const float top = FMath::Lerp(field[y0 * mN + x0], field[y0 * mN + x1], fracX);
+	const float bottom = FMath::Lerp(field[y1 * mN + x0], field[y1 * mN + x1], fracX);
+	
+	return FMath::Lerp(top, bottom, fracY);
+}
+
+
+float OceanHeightPyramid::SampleHeight(float x, float y) const
+{
+	const float invCellSize = 1.0f / mCellSize;
+	const float targetX = x * invCellSize;
+	const float targetY = y * invCellSize;
+
+	// Find the rest position u with u + D(u) = target
+	float restX = targetX;
+	float restY = targetY;
+	
+	for (int step = 0; step < DisplacementInversionSteps; step++)
+	{
+		restX = targetX - SampleField(mDisplacementX, restX, restY) * invCellSize;
+		restY = targetY - SampleField(mDisplacementY, restX, restY) * invCellSize;
+	}
+
+	return SampleField(mHeight, restX, restY);
+}
+
+
+float OceanHeightPyramid::Evaluate(const FRay& ray, float t) const
+{
+	const FVector3f position = ray.Origin + ray.Direction * t;
+	return position.Z - SampleHeight(position.X, position.Y);
+}
+
+
+bool OceanHeightPyramid::FindCandidate(const FRay& ray, float& t, float tEnd, float& cellExit) const
+{
+	const int topLevel = mLevels.Num() - 1;
+	const float invCellSize = 1.0f / mCellSize;
+
+	// Horizontal motion in level 0 cells
+	const float originX = ray.Origin.X * invCellSize;
+	const float originY = ray.Origin.Y * invCellSize;
+	const float directionX = ray.Direction.X * invCellSize;
+	const float directionY = ray.Direction.Y * invCellSize;
+
+	// A thousandth of a level 0 cell, so boundary positions land in the cell being entered
+	const float nudge = 1e-3f / FMath::Max3(FMath::Abs(directionX), FMath::Abs(directionY), UE_SMALL_NUMBER);
+	
+	int level = topLevel;
+	
+	while (t < tEnd)
+	{
+		const float probe = FMath::Min(t + nudge, tEnd);
+		if (probe <= t)
+			return false;
+		
+		const int size = mN >> level;
+		const float cellSize = (float)(1 << level);
+		const float cellX = FMath::FloorToFloat((originX + probe * directionX) / cellSize);
+		const float cellY = FMath::FloorToFloat((originY + probe * directionY) / cellSize);
+
+		float exit = tEnd;
+		if (directionX != 0.0f) exit = FMath::Min(exit, ((cellX + (directionX > 0.0f)) * cellSize - originX) / directionX);
+		if (directionY != 0.0f) exit = FMath::Min(exit, ((cellY + (directionY > 0.0f)) * cellSize - originY) / directionY);
+		exit = FMath::Max(exit, probe);
+
+		const FVector2f bounds = mLevels[level][WrapCell(cellY, size) * size + WrapCell(cellX, size)];
+		const float z0 = ray.Origin.Z + t * ray.Direction.Z;
+		const float z1 = ray.Origin.Z + exit * ray.Direction.Z;
+
+		if (FMath::Max(z0, z1) < bounds.X || FMath::Min(z0, z1) > bounds.Y)
+		{
+			// Entirely above or below everything in this cell, skip it and try a coarser one next
+			t = exit;
+			level = FMath::Min(level + 1, topLevel);
+		}
+		else if (level > 0)
+		{
+			level--;
+		}
+		else
+		{
+			cellExit = exit;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void OceanHeightPyramid::IntersectPacket(const FRay* rays, FHit* hits, int numRays) const
+{
+	// Missing lanes repeat the last ray and are masked off
+	alignas(16) float originZ[PacketSize];
+	alignas(16) float directionZ[PacketSize];
+	alignas(16) float maxDistance[PacketSize];
+	
+	for (int lane = 0; lane < PacketSize; lane++)
+	{
+		const FRay& ray = rays[FMath::Min(lane, numRays - 1)];
+		originZ[lane] = ray.Origin.Z;
+		directionZ[lane] = ray.Direction.Z;
+		maxDistance[lane] = ray.MaxDistance;
+		
+		if (lane < numRays) hits[lane] = FHit();
+	}
+
+	// Clip every lane against the slab between the lowest and highest point of the surface
+	const FVector2f range = mLevels.Last()[0];
+	const VectorRegister4Float zero = VectorZeroFloat();
+	const VectorRegister4Float rangeMin = VectorSetFloat1(range.X);
+	const VectorRegister4Float rangeMax = VectorSetFloat1(range.Y);
+	const VectorRegister4Float oz = VectorLoadAligned(originZ);
+	const VectorRegister4Float dz = VectorLoadAligned(directionZ);
+	const VectorRegister4Float maxT = VectorLoadAligned(maxDistance);
+
+	const VectorRegister4Float horizontal = VectorCompareLT(VectorAbs(dz), VectorSetFloat1(UE_SMALL_NUMBER));
+	const VectorRegister4Float invDz = VectorDivide(VectorOneFloat(), VectorSelect(horizontal, VectorOneFloat(), dz));
+	const VectorRegister4Float t0 = VectorMultiply(VectorSubtract(rangeMin, oz), invDz);
+	const VectorRegister4Float t1 = VectorMultiply(VectorSubtract(rangeMax, oz), invDz);
+	
+	// Horizontal rays either stay inside the slab all the way or never enter it
+	const VectorRegister4Float insideSlab = VectorBitwiseAnd(VectorCompareGE(oz, rangeMin), VectorCompareLE(oz, rangeMax));
+	const VectorRegister4Float enter = VectorSelect(horizontal, zero, VectorMax(VectorMin(t0, t1), zero));
+	const VectorRegister4Float exit = VectorSelect(horizontal, VectorSelect(insideSlab, maxT, VectorSetFloat1(-1.0f)), VectorMin(VectorMax(t0, t1), maxT));
+
+	alignas(16) float segmentStart[PacketSize];
+	alignas(16) float segmentEnd[PacketSize];
+	VectorStoreAligned(enter, segmentStart);
+	VectorStoreAligned(exit, segmentEnd);
+
+	int activeLanes = VectorMaskBits(VectorCompareLE(enter, exit)) & ((1 << numRays) - 1);
+
+	alignas(16) float a[PacketSize], b[PacketSize], fa[PacketSize], fb[PacketSize], fm[PacketSize], cellExit[PacketSize];
+	
+	while (activeLanes)
+	{
+		// Traversal diverges per ray, every active lane walks the pyramid to its next candidate cell
+		int candidateLanes = 0;
+		for (int lane = 0; lane < PacketSize; lane++)
+		{
+			if (!(activeLanes & (1 << lane)))
+				continue;
+
+			if (FindCandidate(rays[lane], segmentStart[lane], segmentEnd[lane], cellExit[lane]))
+			{
+				// Grazing rays can enter and leave the surface within one cell, bracket the first sign change
+				// among a few samples rather than only comparing the ends
+				const float start = segmentStart[lane];
+				const float span = cellExit[lane] - start;
+				
+				a[lane] = start;
+				fa[lane] = Evaluate(rays[lane], start);
+				
+				for (int sample = 1; sample <= CandidateSamples; sample++)
+				{
+					b[lane] = start + span * sample / CandidateSamples;
+					fb[lane] = Evaluate(rays[lane], b[lane]);
+					
+					if (fa[lane] * fb[lane] <= 0.0f || sample == CandidateSamples)
+						break;
+					
+					a[lane] = b[lane];
+					fa[lane] = fb[lane];
+				}
+				
+				candidateLanes |= 1 << lane;
+			}
+			else
+			{
+				activeLanes &= ~(1 << lane);
+			}
+		}
+
+		// Inactive lanes hold a dummy bracket that the arithmetic below leaves alone
+		for (int lane = 0; lane < PacketSize; lane++)
+		{
+			if (!(candidateLanes & (1 << lane)))
+			{
+				a[lane] = 0.0f; b[lane] = 1.0f; fa[lane] = 1.0f; fb[lane] = 1.0f;
+			}
+		}
+
+		VectorRegister4Float va = VectorLoadAligned(a);
+		VectorRegister4Float vb = VectorLoadAligned(b);
+		VectorRegister4Float vfa = VectorLoadAligned(fa);
+		VectorRegister4Float vfb = VectorLoadAligned(fb);
+
+		// The ray changes sides of the surface within the cell
+		const int crossingLanes = candidateLanes & VectorMaskBits(VectorCompareLE(VectorMultiply(vfa, vfb), zero));
+
+		// Refine all bracketed lanes together with regula falsi, only the surface samples are per lane
+		for (int step = 0; step < RefinementSteps && crossingLanes; step++)
+		{
+			const VectorRegister4Float denominator = VectorSubtract(vfb, vfa);
+			const VectorRegister4Float degenerate = VectorCompareLT(VectorAbs(denominator), VectorSetFloat1(UE_SMALL_NUMBER));
+			const VectorRegister4Float secant = VectorSubtract(vb, VectorDivide(VectorMultiply(vfb, VectorSubtract(vb, va)), VectorSelect(degenerate, VectorOneFloat(), denominator)));
+			const VectorRegister4Float midpoint = VectorMultiply(VectorAdd(va, vb), VectorSetFloat1(0.5f));
+			const VectorRegister4Float vm = VectorSelect(degenerate, midpoint, secant);
+
+			alignas(16) float m[PacketSize];
+			VectorStoreAligned(vm, m);
+			for (int lane = 0; lane < PacketSize; lane++)
+			{
+				fm[lane] = (crossingLanes & (1 << lane)) ? Evaluate(rays[lane], m[lane]) : 1.0f;
+			}
+			const VectorRegister4Float vfm = VectorLoadAligned(fm);
+
+			// Keep the half that still brackets the crossing
+			const VectorRegister4Float replaceA = VectorCompareGT(VectorMultiply(vfm, vfa), zero);
+			va = VectorSelect(replaceA, vm, va);
+			vfa = VectorSelect(replaceA, vfm, vfa);
+			vb = VectorSelect(replaceA, vb, vm);
+			vfb = VectorSelect(replaceA, vfb, vfm);
+		}
+
+		const VectorRegister4Float closerToA = VectorCompareLT(VectorAbs(vfa), VectorAbs(vfb));
+		alignas(16) float distance[PacketSize];
+		VectorStoreAligned(VectorSelect(closerToA, va, vb), distance);
+
+		for (int lane = 0; lane < PacketSize; lane++)
+		{
+			if (crossingLanes & (1 << lane))
+			{
+				hits[lane].bHit = true;
+				hits[lane].Distance = distance[lane];
+				hits[lane].Position = rays[lane].Origin + rays[lane].Direction * distance[lane];
+				activeLanes &= ~(1 << lane);
+			}
+			else if (candidateLanes & (1 << lane))
+			{
+				// No crossing in this cell, resume behind it
+				segmentStart[lane] = cellExit[lane];
+			}
+		}
+	}
+}
+
+
+void OceanHeightPyramid::Intersect(TArrayView<const FRay> rays, TArrayView<FHit> hits, OceanWorkerPool* pool) const
+{
+	check(IsValid() && rays.Num() == hits.Num());
+
+	const int numPackets = FMath::DivideAndRoundUp(rays.Num(), PacketSize);
+
+	auto intersectPackets = [&](int firstPacket, int lastPacket)
+	{
+		for (int packet = firstPacket; packet < lastPacket; packet++)
+		{
+			const int first = packet * PacketSize;
+			IntersectPacket(&rays[first], &hits[first], FMath::Min(PacketSize, rays.Num() - first));
+		}
+	};
+
+	if (pool && numPackets > PacketsPerTask)
+	{
+		pool->ParallelFor(FMath::DivideAndRoundUp(numPackets, PacketsPerTask), [&](int task)
+		{
+			intersectPackets(task * PacketsPerTask, FMath::Min((task + 1) * PacketsPerTask, numPackets));
+		});
+	}
+	else
+	{
+		intersectPackets(0, numPackets);
+	}
+}
+
+
+static FAutoConsoleCommand GOceanCheckHeightPyramidCommand(
+	TEXT("Ocean.HeightPyramid.Check"),
+	TEXT("Intersects [Rays] (default 2000) random rays with a CPU simulated surface through the pyramid and by brute-force marching, and fails if only one of them hits a ray or their hit distances differ by more than the march step"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args)
+	{
+		const int numRays = args.Num() > 0 ? FMath::Max(FCString::Atoi(*args[0]), 1) : 2000;
+
+		OceanCPUSimulation simulation;
+		OceanTextureManager::FSpectrumParameters spectrumParameters = simulation.GetSpectrumParameters();
+		spectrumParameters.N = 256;
+		simulation.SetSpectrumParameters(spectrumParameters);
+		simulation.ComputeDisplacement(1000.0);
+
+		const int N = spectrumParameters.N;
+		const float L = spectrumParameters.L;
+		const float cellSize = L / N;
+
+		// Scaled to waves a few cells high so rays cross the surface at every angle, the horizontal displacement
+		// less so the surface does not fold
+		float maxHeight = UE_SMALL_NUMBER;
+		for (float height : simulation.GetDisplacement(1))
+		{
+			maxHeight = FMath::Max(maxHeight, FMath::Abs(height));
+		}
+		const float scale = 2.0f * cellSize / maxHeight;
+
+		TArray<float> fields[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			fields[axis] = TArray<float>(simulation.GetDisplacement(axis));
+			for (float& value : fields[axis])
+			{
+				value *= axis == 1 ? scale : 0.75f * scale;
+			}
+		}
+
+		OceanHeightPyramid pyramid;
+		pyramid.Build(fields[0], fields[1], fields[2], N, L, OceanWorkerPool::Get());
+		const FVector2f bounds = pyramid.GetBounds(pyramid.GetNumLevels() - 1, 0, 0);
+
+		// Mostly descending rays starting above and inside the surface's height range, some rising from below it
+		FRandomStream random(0x0CEA4);
+		TArray<OceanHeightPyramid::FRay> rays;
+		rays.SetNum(numRays);
+		for (int i = 0; i < numRays; i++)
+		{
+			OceanHeightPyramid::FRay& ray = rays[i];
+			ray.Origin = FVector3f(random.FRandRange(-2.0f * L, 2.0f * L), random.FRandRange(-2.0f * L, 2.0f * L), random.FRandRange(bounds.X, bounds.Y + 4.0f * cellSize));
+			ray.Direction = FVector3f(random.FRandRange(-1.0f, 1.0f), random.FRandRange(-1.0f, 1.0f), -random.FRandRange(0.02f, 1.0f));
+			if (i % 8 == 0)
+			{
+				ray.Origin.Z = bounds.X - cellSize;
+				ray.Direction.Z = -ray.Direction.Z;
+			}
+			ray.MaxDistance = 2.0f * L;
+		}
+
+		TArray<OceanHeightPyramid::FHit> hits;
+		hits.SetNum(numRays);
+		pyramid.Intersect(rays, hits, &OceanWorkerPool::Get());
+
+		// Marches a twentieth of a cell at a time and bisects the first sign change
+		const float marchStepCells = 0.05f;
+		auto bruteForce = [&pyramid, &bounds, cellSize, marchStepCells](const OceanHeightPyramid::FRay& ray, float& distance)
+		{
+			auto above = [&](float t)
+			{
+				const FVector3f position = ray.Origin + ray.Direction * t;
+				return position.Z - pyramid.SampleHeight(position.X, position.Y);
+			};
+
+			const float step = marchStepCells * cellSize / ray.Direction.Size();
+			const bool startAbove = above(0.0f) > 0.0f;
+
+			for (float t = step; t - step < ray.MaxDistance; t += step)
+			{
+				const float end = FMath::Min(t, ray.MaxDistance);
+				if ((above(end) > 0.0f) != startAbove)
+				{
+					float low = end - step;
+					float high = end;
+					for (int i = 0; i < 32; i++)
+					{
+						const float middle = 0.5f * (low + high);
+						((above(middle) > 0.0f) == startAbove ? low : high) = middle;
+					}
+					distance = 0.5f * (low + high);
+					return true;
+				}
+
+				// Past the height range and moving away from it
+				const float z = ray.Origin.Z + end * ray.Direction.Z;
+				if ((z > bounds.Y && ray.Direction.Z >= 0.0f) || (z < bounds.X && ray.Direction.Z <= 0.0f))
+					return false;
+			}
+
+			return false;
+		};
+
+		int bothHit = 0;
+		int onlyPyramid = 0;
+		int onlyBruteForce = 0;
+		float maxError = 0.0f;
+		float maxErrorCells = 0.0f;
+
+		for (int i = 0; i < numRays; i++)
+		{
+			float distance = 0.0f;
+			const bool hit = bruteForce(rays[i], distance);
+
+			if (hit && hits[i].bHit)
+			{
+				bothHit++;
+				const float error = FMath::Abs(distance - hits[i].Distance);
+				maxError = FMath::Max(maxError, error);
+				maxErrorCells = FMath::Max(maxErrorCells, error * rays[i].Direction.Size() / cellSize);
+			}
+			else if (hit)
+			{
+				onlyBruteForce++;
+			}
+			else if (hits[i].bHit)
+			{
+				onlyPyramid++;
+			}
+		}
+
+		UE_LOG(LogOcean, Display, TEXT("Height pyramid N=%d, %d rays: %d hit by both, %d only by brute force, %d only by the pyramid; maximum hit distance error %g (%g cells)"),
+			N, numRays, bothHit, onlyBruteForce, onlyPyramid, maxError, maxErrorCells);
+		ensureMsgf(onlyBruteForce == 0 && onlyPyramid == 0, TEXT("Ocean height pyramid missed %d and invented %d hits"), onlyBruteForce, onlyPyramid);
+		ensureMsgf(maxErrorCells <= marchStepCells, TEXT("Ocean height pyramid hit distance off by %g cells"), maxErrorCells);
+	}));
@@ -0,0 +1,122 @@
+#include "OceanReadbackRing.h"
+
+#include "CustomShaders.h"
+#include "HAL/IConsoleManager.h"
+
+
+void FOceanCPUReadbackBackend::Copy(FStaging& staging, const FSource& source)
+{
+	staging.N = source.N;
+	staging.ReadyAt = Tick + Latency + (Jitter > 0 ? Random.RandRange(0, Jitter) : 0);
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (!source.Axes[axis])
+		{
+			staging.Axes[axis].Reset();
+			continue;
+		}
+
+		staging.Axes[axis].SetNumUninitialized(source.N * source.N);
+		FMemory::Memcpy(staging.Axes[axis].GetData(), source.Axes[axis], source.N * source.N * sizeof(float));
+		CopiedBytes += source.N * source.N * sizeof(float);
+	}
+}
+
+
+void FOceanCPUReadbackBackend::Read(FStaging& staging, FOceanReadbackFrame& frame)
+{
+	frame.N = staging.N;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		frame.Axes[axis] = staging.Axes[axis];
+	}
+}
+
+
+namespace
+{
+	using FCPURing = TOceanReadbackRing<FOceanCPUReadbackBackend>;
+
+	struct FConsumerStats
+	{
+		int64 Reads = 0;
+		// Reads whose frame was older than the previous read's
+		int64 Backwards = 0;
+		// Reads whose height wasn't the one submitted for their frame
+		int64 Mismatched = 0;
+		// Frames between the newest submission and what the consumer saw
+		int64 TotalLag = 0;
+		int64 MaxLag = 0;
+	};
+}
+
+
+static FAutoConsoleCommand GOceanReadbackCheckCommand(
+	TEXT("Ocean.Readback.Check"),
+	TEXT("Runs the readback ring on the CPU stand-in backend for [Frames] (default 240) simulated frames at several slot counts, latencies and jitters and logs what a consumer reading every frame saw. Fails if it saw a frame go backwards, a mismatched field or more lag than the latency allows."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args)
+	{
+		const int frames = args.Num() > 0 ? FMath::Max(FCString::Atoi(*args[0]), 1) : 240;
+		const int N = 16;
+
+		auto run = [frames, N](int numSlots, int latency, int jitter)
+		{
+			FCPURing ring(numSlots);
+			ring.GetBackend().Latency = latency;
+			ring.GetBackend().Jitter = jitter;
+
+			// Every texel of frame f's height is f, so a read of the wrong frame or a mixed one shows
+			TArray<float> height;
+			height.SetNumUninitialized(N * N);
+
+			FConsumerStats stats;
+			uint64 lastFrame = 0;
+
+			for (int frame = 1; frame <= frames; frame++)
+			{
+				for (float& h : height)
+				{
+					h = (float)frame;
+				}
+
+				FOceanCPUReadbackBackend::FSource source;
+				source.N = N;
+				source.Axes[1] = height.GetData();
+
+				ring.Poll();
+				ring.Submit(source, frame * ring.GetBackend().TickSeconds);
+				ring.GetBackend().Tick++;
+
+				const FCPURing::FFramePtr latest = ring.GetLatest();
+				if (!latest)
+					continue;
+
+				stats.Reads++;
+				stats.Backwards += latest->Frame < lastFrame ? 1 : 0;
+				stats.Mismatched += latest->Axes[1].Num() != N * N || latest->Axes[1][N * N - 1] != (float)latest->Frame || latest->Axes[1][0] != (float)latest->Frame;
+				stats.TotalLag += frame - latest->Frame;
+				stats.MaxLag = FMath::Max<int64>(stats.MaxLag, frame - latest->Frame);
+				lastFrame = latest->Frame;
+			}
+
+			const FCPURing::FStats& ringStats = ring.GetStats();
+			const FCPURing::FFramePtr latest = ring.GetLatest();
+			UE_LOG(LogOcean, Display, TEXT("Readback %d slots, latency %d + %d: %lld submitted, %lld dropped, %lld published, %lld superseded; consumer lag %.2f average %lld max frames, latency %.1f ms, %lld backwards, %lld mismatched"),
+				numSlots, latency, jitter, ringStats.Submitted, ringStats.Dropped, ringStats.Published, ringStats.Superseded,
+				stats.Reads > 0 ? (double)stats.TotalLag / stats.Reads : 0.0, stats.MaxLag,
+				latest ? latest->AverageLatency * 1000.0 : 0.0, stats.Backwards, stats.Mismatched);
+
+			// A copy lands at most latency + jitter frames late, every slot too few for that drops up to another frame
+			const int64 maxLag = latency + jitter + FMath::Max(0, latency + jitter + 1 - numSlots);
+			ensureMsgf(stats.Backwards == 0, TEXT("Ocean readback (%d slots, latency %d + %d) went backwards %lld times"), numSlots, latency, jitter, stats.Backwards);
+			ensureMsgf(stats.Mismatched == 0, TEXT("Ocean readback (%d slots, latency %d + %d) read %lld mismatched fields"), numSlots, latency, jitter, stats.Mismatched);
+			ensureMsgf(stats.Reads > 0 && stats.MaxLag <= maxLag, TEXT("Ocean readback (%d slots, latency %d + %d) lagged %lld frames, at most %lld expected"), numSlots, latency, jitter, stats.MaxLag, maxLag);
+		};
+
+		// Enough slots for the latency, too few, and copies landing out of order
+		run(3, 2, 0);
+		run(2, 3, 0);
+		run(4, 1, 2);
+	}));
@@ -0,0 +1,97 @@
+#include "OceanResolutionController.h"
+
+#include "CustomShaders.h"
+#include "OceanTextureManager.h"
+
+
+OceanResolutionController::OceanResolutionController(OceanTextureManager& manager, int initialN)
+	: mManager(manager)
+	, mN(initialN)
+{
+	check(FMath::IsPowerOfTwo(initialN));
+}
+
+
+void OceanResolutionController::SetSettings(const FSettings& settings)
+{
+	check(FMath::IsPowerOfTwo(settings.MinN) && FMath::IsPowerOfTwo(settings.MaxN) && settings.MinN <= settings.MaxN);
+	mSettings = settings;
+
+	const int clampedN = FMath::Clamp(mN, mSettings.MinN, mSettings.MaxN);
+	if (clampedN != mN)
+	{
+		SwitchTo(clampedN);
+	}
+}
+
+
+int OceanResolutionController::Update(float costMs)
+{
+	mFramesSinceSwitch++;
+	
+	if (costMs >= 0.0f && mFramesSinceSwitch > mSettings.SettleFrames)
+	{
+		mSmoothedCostMs = mSmoothedCostMs < 0.0 ? costMs : FMath::Lerp(mSmoothedCostMs, (double)costMs, (double)mSettings.Smoothing);
+	}
+
+	// Spread the warm-up over two frames, each neighbour costs a few dispatches and possibly a texture upload
+	if (mPrewarmUpPending)
+	{
+		mPrewarmUpPending = false;
+		if (mN * 2 <= mSettings.MaxN)
+		{
+			mManager.PrewarmResolution(mN * 2);
+		}
+	}
+	else if (mPrewarmDownPending)
+	{
+		mPrewarmDownPending = false;
+		if (mN / 2 >= mSettings.MinN)
+		{
+			mManager.PrewarmResolution(mN / 2);
+		}
+	}
+
+	if (mSmoothedCostMs < 0.0 || mFramesSinceSwitch < mSettings.CooldownFrames)
+		return mN;
+
+	if (mSmoothedCostMs > mSettings.BudgetMs && mN / 2 >= mSettings.MinN)
+	{
+		SwitchTo(mN / 2);
+	}
+	else if (mN * 2 <= mSettings.MaxN
+		&& PredictCost(mSmoothedCostMs, mN, mN * 2) <= mSettings.BudgetMs * mSettings.UpscaleHeadroom
+		&& mManager.IsResolutionWarm(mN * 2))
+	{
+		SwitchTo(mN * 2);
+	}
+
+	return mN;
+}
+
+
+double OceanResolutionController::PredictCost(double costMs, int fromN, int toN)
+{
+	const double fromWork = (double)fromN * fromN * FMath::Log2((double)fromN);
+	const double toWork = (double)toN * toN * FMath::Log2((double)toN);
+	
+	return costMs * toWork / fromWork;
+}
+
+
+void OceanResolutionController::SwitchTo(int N)
+{
+	UE_LOG(LogOcean, Log, TEXT("Ocean resolution %d -> %d (smoothed cost %.3f ms, budget %.3f ms)"), mN, N, mSmoothedCostMs, mSettings.BudgetMs);
+
+	// Until the first samples at the new N arrive, go by the prediction
+	if (mSmoothedCostMs >= 0.0)
+	{
+		mSmoothedCostMs = PredictCost(mSmoothedCostMs, mN, N);
+	}
+	
+	mManager.SetResolution(N);
+	mN = N;
+	mFramesSinceSwitch = 0;
+	mPrewarmUpPending = true;
+	mPrewarmDownPending = true;
+}
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "OceanResourcePool.h"
+
+#include "CustomShaders.h"
+#include "HAL/IConsoleManager.h"
+#include "OceanTextureManager.h"
+
+
+FOceanCPUResourceBackend::FResource FOceanCPUResourceBackend::Allocate(const FOceanResourceKey& key)
+{
+	FResource texture = MakeShared<FTexture>();
+	texture->N = key.N;
+	texture->Format = key.Format;
+	texture->Texels.SetNumZeroed(key.N * key.N);
+
+	AllocatedBytes += texture->Texels.Num() * sizeof(FVector4f);
+	return texture;
+}
+
+
+bool FOceanCPUResourceBackend::Copy(const FResource& source, const FTarget& target)
+{
+	// Like the GPU copy, targets not resized to the current N yet are skipped
+	if (target->N != source->N || target->Format != source->Format)
+		return false;
+
+	target->Texels = source->Texels;
+	CopiedBytes += source->Texels.Num() * sizeof(FVector4f);
+	return true;
+}
+
+
+namespace
+{
+	using FCPUPool = TOceanResourcePool<FOceanCPUResourceBackend>;
+
+	// One displacement request through the same pool calls as OceanTextureManager's pipeline, every output texel is
+	// written with value. The Fourier components go to fourierComponents, which holds them for as long as the
+	// request they belong to is in flight.
+	void RunFrame(FCPUPool& pool, int N, EOceanOutputs outputs, FOceanCPUResourceBackend::FTexture* (&targets)[FCPUPool::FOutputs::NumChannels], float value, FOceanCPUResourceBackend::FResource (&fourierComponents)[3])
+	{
+		bool computed[FCPUPool::FOutputs::NumChannels], written[FCPUPool::FOutputs::NumChannels];
+		OceanTextureManager::GetDisplacementChannels(outputs, computed, written);
+
+		pool.AcquireFourierComponents(N, PF_A32B32G32R32F, computed, fourierComponents);
+		const FCPUPool::FOutputs frameOutputs = pool.BeginOutputs(N, PF_A32B32G32R32F, targets, computed, written);
+
+		for (int channel = 0; channel < FCPUPool::FOutputs::NumChannels; channel++)
+		{
+			if (!computed[channel])
+				continue;
+
+			FOceanCPUResourceBackend::FTexture* destination = frameOutputs.Direct[channel] ? frameOutputs.Targets[channel] : frameOutputs.Intermediates[channel].Get();
+			for (FVector4f& texel : destination->Texels)
+			{
+				texel = FVector4f(value, value, value, value);
+			}
+		}
+
+		pool.FinishOutputs(frameOutputs);
+	}
+
+	// Targets of the channels outputs writes hold value, the others were never touched and are still zero
+	bool TargetsHold(FOceanCPUResourceBackend::FTexture* (&targets)[FCPUPool::FOutputs::NumChannels], EOceanOutputs outputs, float value)
+	{
+		bool computed[FCPUPool::FOutputs::NumChannels], written[FCPUPool::FOutputs::NumChannels];
+		OceanTextureManager::GetDisplacementChannels(outputs, computed, written);
+
+		for (int channel = 0; channel < FCPUPool::FOutputs::NumChannels; channel++)
+		{
+			const float expected = written[channel] ? value : 0.0f;
+			for (const FVector4f& texel : targets[channel]->Texels)
+			{
+				if (texel.X != expected)
+					return false;
+			}
+		}
+		return true;
+	}
+}
+
+
+static FAutoConsoleCommand GOceanResourcePoolCheckCommand(
+	TEXT("Ocean.ResourcePool.Check"),
+	TEXT("Runs the displacement pipeline's pool calls on the CPU resource backend for [Frames] (default 16) frames: with targets that can be written directly, with targets that can't, with two requests in flight, across a resolution switch and for outputs that only compute some channels. Fails if anything is allocated after the first frame of a resolution (the second too with two in flight), if writable targets are copied into, if a target is stale or if a target of a channel that was not asked for is written."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args)
+	{
+		const int frames = args.Num() > 0 ? FMath::Max(FCString::Atoi(*args[0]), 2) : 16;
+
+		auto makeTargets = [](int N, bool writable, FOceanCPUResourceBackend::FTexture (&storage)[FCPUPool::FOutputs::NumChannels], FOceanCPUResourceBackend::FTexture* (&targets)[FCPUPool::FOutputs::NumChannels])
+		{
+			for (int channel = 0; channel < FCPUPool::FOutputs::NumChannels; channel++)
+			{
+				storage[channel].N = N;
+				storage[channel].Format = PF_A32B32G32R32F;
+				storage[channel].bWritable = writable;
+				storage[channel].Texels.SetNumZeroed(N * N);
+				targets[channel] = &storage[channel];
+			}
+		};
+
+		auto run = [frames, &makeTargets](const TCHAR* name, EOceanOutputs outputs, bool writable, bool overlapping, int firstN, int secondN)
+		{
+			FCPUPool pool;
+			FOceanCPUResourceBackend::FTexture storage[FCPUPool::FOutputs::NumChannels];
+			FOceanCPUResourceBackend::FTexture* targets[FCPUPool::FOutputs::NumChannels];
+			makeTargets(firstN, writable, storage, targets);
+
+			// Components of the request still in flight when overlapping
+			FOceanCPUResourceBackend::FResource inFlight[3];
+
+			bool upToDate = true;
+			bool allocatedWhenWarm = false;
+			int firstFrameOfN = 0;
+
+			for (int frame = 0; frame < frames; frame++)
+			{
+				// Switch half way through, the pool drops the old buffers by itself
+				const int N = frame < frames / 2 ? firstN : secondN;
+				if (frame == frames / 2 && secondN != firstN)
+				{
+					makeTargets(N, writable, storage, targets);
+					firstFrameOfN = frame;
+				}
+
+				const int64 allocations = pool.GetStats().Allocations;
+
+				FOceanCPUResourceBackend::FResource fourierComponents[3];
+				RunFrame(pool, N, outputs, targets, frame + 1.0f, fourierComponents);
+
+				for (int axis = 0; axis < 3; axis++)
+				{
+					inFlight[axis] = overlapping ? fourierComponents[axis] : FOceanCPUResourceBackend::FResource();
+				}
+
+				// A second set of Fourier components is only needed once a request is in flight
+				const bool warm = frame > firstFrameOfN + (overlapping ? 1 : 0);
+				allocatedWhenWarm |= warm && pool.GetStats().Allocations != allocations;
+
+				upToDate &= TargetsHold(targets, outputs, frame + 1.0f);
+			}
+
+			const FCPUPool::FStats& stats = pool.GetStats();
+			UE_LOG(LogOcean, Display, TEXT("ResourcePool %s: %d frames, %lld allocations (%.1f MB), %lld reuses, %lld direct writes, %lld copies (%.1f MB), %d buffers held, targets %s"),
+				name, frames, stats.Allocations, pool.GetBackend().AllocatedBytes / (1024.0 * 1024.0), stats.Reuses, stats.DirectWrites,
+				stats.Copies, pool.GetBackend().CopiedBytes / (1024.0 * 1024.0), pool.Num(), upToDate ? TEXT("up to date") : TEXT("stale"));
+
+			ensureMsgf(!allocatedWhenWarm, TEXT("Ocean resource pool (%s) allocated after warm-up"), name);
+			ensureMsgf(!writable || stats.Copies == 0, TEXT("Ocean resource pool (%s) copied into writable targets"), name);
+			ensureMsgf(upToDate, TEXT("Ocean resource pool (%s) left targets stale or wrote ones it wasn't asked for"), name);
+		};
+
+		run(TEXT("writable targets"), EOceanOutputs::All, true, false, 256, 256);
+		run(TEXT("targets without UAV"), EOceanOutputs::All, false, false, 256, 256);
+		run(TEXT("two requests in flight"), EOceanOutputs::All, true, true, 256, 256);
+		run(TEXT("resolution switch"), EOceanOutputs::All, true, false, 256, 512);
+		// X, Z and the normals are computed without being asked for, their targets have to stay untouched
+		run(TEXT("normals only"), EOceanOutputs::Normals, true, false, 256, 256);
+		run(TEXT("foam only"), EOceanOutputs::Foam, true, false, 256, 256);
+		run(TEXT("height only"), EOceanOutputs::Height, false, false, 256, 256);
+	}));
@@ -0,0 +1,341 @@
+#include "OceanSharedFieldPublisher.h"
+
+#include "Async/Async.h"
+#include "CustomShaders.h"
+#include "HAL/IConsoleManager.h"
+#include "OceanCPUSimulation.h"
+
+
+static const uint32 ReadAccess = (uint32)FPlatformMemory::ESharedMemoryAccess::Read;
+static const uint32 ReadWriteAccess = ReadAccess | (uint32)FPlatformMemory::ESharedMemoryAccess::Write;
+
+
+OceanSharedFieldPublisher::OceanSharedFieldPublisher(const FString& name, int maxN, int numSlots)
+	: mMaxN(maxN)
+{
+	using namespace OceanSharedField;
+
+	// With a single slot the producer would overwrite the frame readers are on every time
+	check(maxN > 0 && numSlots > 1);
+
+	mRegion = FPlatformMemory::MapNamedSharedMemoryRegion(name, true, ReadWriteAccess, GetRegionSize(maxN, numSlots));
+	if (!mRegion)
+	{
+		UE_LOG(LogOcean, Error, TEXT("Could not create shared memory region %s"), *name);
+		return;
+	}
+
+	mHeader = static_cast<FHeader*>(mRegion->GetAddress());
+
+	// Readers still attached to a previous producer see an invalid region until the layout is complete
+	mHeader->Magic.store(0, std::memory_order_relaxed);
+	mHeader->LayoutVersion = LayoutVersion;
+	mHeader->NumSlots = numSlots;
+	mHeader->MaxN = maxN;
+	mHeader->SlotStride = GetSlotStride(maxN);
+	mHeader->LatestFrame.store(0, std::memory_order_relaxed);
+
+	for (int slot = 0; slot < numSlots; slot++)
+	{
+		GetSlot(mHeader, slot)->Sequence.store(0, std::memory_order_relaxed);
+	}
+
+	mHeader->Magic.store(Magic, std::memory_order_release);
+}
+
+
+OceanSharedFieldPublisher::~OceanSharedFieldPublisher()
+{
+	if (mRegion)
+	{
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(mRegion);
+	}
+}
+
+
+void OceanSharedFieldPublisher::BeginFrame(double time, int N, float L, uint32 axisMask, float* axes[OceanSharedField::NumAxes])
+{
+	using namespace OceanSharedField;
+
+	check(!mOpenSlot);
+
+	for (int axis = 0; axis < NumAxes; axis++)
+	{
+		axes[axis] = nullptr;
+	}
+
+	// Frames larger than the region was sized for are not published
+	if (!mHeader || N > mMaxN)
+		return;
+
+	mFrame++;
+	mOpenSlot = GetSlot(mHeader, mFrame);
+
+	// Odd sequence first, the release fence keeps the slot writes below from becoming visible before it
+	mOpenSlot->Sequence.store(mOpenSlot->Sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	mOpenSlot->Frame = mFrame;
+	mOpenSlot->Time = time;
+	mOpenSlot->N = N;
+	mOpenSlot->L = L;
+	mOpenSlot->AxisMask = axisMask;
+
+	for (int axis = 0; axis < NumAxes; axis++)
+	{
+		if (axisMask & (1u << axis))
+		{
+			axes[axis] = GetAxis(mHeader, mOpenSlot, axis);
+		}
+	}
+}
+
+
+void OceanSharedFieldPublisher::EndFrame()
+{
+	if (!mOpenSlot)
+		return;
+
+	mOpenSlot->PublishedAt = FPlatformTime::Seconds();
+	mOpenSlot->Sequence.store(mOpenSlot->Sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	mHeader->LatestFrame.store(mFrame, std::memory_order_release);
+
+	mOpenSlot = nullptr;
+}
+
+
+void OceanSharedFieldPublisher::Publish(double time, int N, float L, TArrayView<const float> x, TArrayView<const float> y, TArrayView<const float> z)
+{
+	const TArrayView<const float> fields[] = { x, y, z };
+
+	uint32 axisMask = 0;
+	for (int axis = 0; axis < OceanSharedField::NumAxes; axis++)
+	{
+		check(fields[axis].Num() == 0 || fields[axis].Num() == N * N);
+		axisMask |= fields[axis].Num() > 0 ? 1u << axis : 0u;
+	}
+
+	float* axes[OceanSharedField::NumAxes];
+	BeginFrame(time, N, L, axisMask, axes);
+
+	for (int axis = 0; axis < OceanSharedField::NumAxes; axis++)
+	{
+		if (axes[axis])
+		{
+			FMemory::Memcpy(axes[axis], fields[axis].GetData(), N * N * sizeof(float));
+		}
+	}
+
+	EndFrame();
+}
+
+
+OceanSharedFieldReader::OceanSharedFieldReader(const FString& name)
+{
+	using namespace OceanSharedField;
+
+	// The size of the region is in its header, so the header is mapped on its own first
+	FPlatformMemory::FSharedMemoryRegion* headerRegion = FPlatformMemory::MapNamedSharedMemoryRegion(name, false, ReadAccess, AlignUp(sizeof(FHeader)));
+	if (!headerRegion)
+	{
+		UE_LOG(LogOcean, Warning, TEXT("Shared memory region %s does not exist"), *name);
+		return;
+	}
+
+	const FHeader* header = static_cast<const FHeader*>(headerRegion->GetAddress());
+	const bool valid = IsValid(header);
+	const uint64 size = valid ? GetRegionSize(header->MaxN, header->NumSlots) : 0;
+	FPlatformMemory::UnmapNamedSharedMemoryRegion(headerRegion);
+
+	if (valid)
+	{
+		mRegion = FPlatformMemory::MapNamedSharedMemoryRegion(name, false, ReadAccess, size);
+	}
+
+	if (mRegion)
+	{
+		header = static_cast<const FHeader*>(mRegion->GetAddress());
+
+		// The producer may have restarted with another size in between
+		if (IsValid(header) && GetRegionSize(header->MaxN, header->NumSlots) == size)
+		{
+			mHeader = header;
+		}
+	}
+
+	if (!mHeader)
+	{
+		UE_LOG(LogOcean, Warning, TEXT("Shared memory region %s is not an initialised ocean field ring"), *name);
+	}
+}
+
+
+OceanSharedFieldReader::~OceanSharedFieldReader()
+{
+	if (mRegion)
+	{
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(mRegion);
+	}
+}
+
+
+namespace
+{
+	struct FConsumerStats
+	{
+		// Frames read consistently
+		int64 Reads = 0;
+		// Frames published while the consumer was on another one
+		int64 Skipped = 0;
+		// Reads given up because the producer was on the slot
+		int64 Retries = 0;
+		double TotalLatency = 0.0;
+		double MaxLatency = 0.0;
+	};
+
+	double SumField(const float* field, int count)
+	{
+		double sum = 0.0;
+		for (int i = 0; i < count; i++)
+		{
+			sum += field[i];
+		}
+		return sum;
+	}
+
+	// Polls for new frames until deadline and sums their heights in place, the way a consumer process would use
+	// the mapped fields. onRead gets the frame and the sum of every consistent read.
+	template <typename FOnRead>
+	FConsumerStats RunConsumer(const OceanSharedField::FHeader* header, double deadline, FOnRead&& onRead)
+	{
+		FConsumerStats stats;
+		uint64 lastFrame = 0;
+
+		while (FPlatformTime::Seconds() < deadline)
+		{
+			if (header->LatestFrame.load(std::memory_order_acquire) == lastFrame)
+			{
+				FPlatformProcess::YieldThread();
+				continue;
+			}
+
+			OceanSharedField::FReadView view;
+			if (!OceanSharedField::BeginRead(header, view))
+			{
+				stats.Retries++;
+				continue;
+			}
+
+			const bool hasHeight = (view.AxisMask & 2u) != 0 && view.N <= (int)header->MaxN;
+			const double heightSum = hasHeight ? SumField(view.Axes[1], view.N * view.N) : 0.0;
+
+			if (!OceanSharedField::EndRead(view))
+			{
+				stats.Retries++;
+				continue;
+			}
+
+			const double latency = FPlatformTime::Seconds() - view.PublishedAt;
+			stats.Reads++;
+			stats.Skipped += lastFrame > 0 ? view.Frame - lastFrame - 1 : 0;
+			stats.TotalLatency += latency;
+			stats.MaxLatency = FMath::Max(stats.MaxLatency, latency);
+			lastFrame = view.Frame;
+
+			onRead(view.Frame, heightSum);
+		}
+
+		return stats;
+	}
+
+	void LogConsumerStats(const FConsumerStats& stats)
+	{
+		UE_LOG(LogOcean, Display, TEXT("Consumer: %lld frames read, %lld skipped, %lld retries, latency %.3f ms average %.3f ms max"),
+			stats.Reads, stats.Skipped, stats.Retries,
+			stats.Reads > 0 ? stats.TotalLatency / stats.Reads * 1000.0 : 0.0, stats.MaxLatency * 1000.0);
+	}
+}
+
+
+static FAutoConsoleCommand GOceanSharedFieldTestCommand(
+	TEXT("Ocean.SharedField.Test"),
+	TEXT("Publishes CPU simulation frames to a shared memory ring at [N] (default 256) for [Seconds] (default 5) while a consumer thread reads them through its own read-only mapping, then fails if any consistent read differs from what was published"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args)
+	{
+		const int N = args.Num() > 0 ? FCString::Atoi(*args[0]) : 256;
+		const double seconds = args.Num() > 1 ? FCString::Atof(*args[1]) : 5.0;
+		const FString name = FString::Printf(TEXT("OceanSharedFieldTest%u"), FPlatformProcess::GetCurrentProcessId());
+
+		OceanSharedFieldPublisher publisher(name, N);
+		OceanSharedFieldReader reader(name);
+		if (!publisher.IsValid() || !reader.GetHeader())
+			return;
+
+		OceanCPUSimulation simulation;
+		OceanTextureManager::FSpectrumParameters spectrumParameters = simulation.GetSpectrumParameters();
+		spectrumParameters.N = N;
+		simulation.SetSpectrumParameters(spectrumParameters);
+		simulation.SetPublisher(&publisher);
+
+		struct FRead
+		{
+			uint64 Frame;
+			double HeightSum;
+		};
+		TArray<FRead> reads;
+
+		const double start = FPlatformTime::Seconds();
+		const double deadline = start + seconds;
+
+		TFuture<FConsumerStats> consumer = Async(EAsyncExecution::Thread, [&]()
+		{
+			return RunConsumer(reader.GetHeader(), deadline, [&](uint64 frame, double heightSum) { reads.Add({ frame, heightSum }); });
+		});
+
+		// Frame f's height sum at index f - 1
+		TArray<double> published;
+		double computeTime = 0.0;
+
+		while (FPlatformTime::Seconds() < deadline)
+		{
+			const double frameStart = FPlatformTime::Seconds();
+			simulation.ComputeDisplacement(frameStart - start);
+			computeTime += FPlatformTime::Seconds() - frameStart;
+
+			const TArrayView<const float> height = simulation.GetDisplacement(1);
+			published.Add(SumField(height.GetData(), height.Num()));
+		}
+
+		const FConsumerStats stats = consumer.Get();
+
+		int inconsistent = 0;
+		for (const FRead& read : reads)
+		{
+			inconsistent += read.Frame < 1 || read.Frame > (uint64)published.Num() || published[read.Frame - 1] != read.HeightSum;
+		}
+
+		UE_LOG(LogOcean, Display, TEXT("Shared field %dx%d: %d frames published at %.2f ms per frame, %d consistent reads differed from the published frame"),
+			N, N, published.Num(), published.Num() > 0 ? computeTime / published.Num() * 1000.0 : 0.0, inconsistent);
+		LogConsumerStats(stats);
+		ensureMsgf(inconsistent == 0, TEXT("Ocean shared field: %d reads were torn or of the wrong frame"), inconsistent);
+	}));
+
+
+static FAutoConsoleCommand GOceanSharedFieldConsumeCommand(
+	TEXT("Ocean.SharedField.Consume"),
+	TEXT("Reads the shared memory ring <Name> published by another process for [Seconds] (default 5) and logs what the consumer saw"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args)
+	{
+		if (args.Num() < 1)
+		{
+			UE_LOG(LogOcean, Warning, TEXT("Usage: Ocean.SharedField.Consume <Name> [Seconds]"));
+			return;
+		}
+
+		OceanSharedFieldReader reader(args[0]);
+		if (!reader.GetHeader())
+			return;
+
+		const double seconds = args.Num() > 1 ? FCString::Atof(*args[1]) : 5.0;
+		LogConsumerStats(RunConsumer(reader.GetHeader(), FPlatformTime::Seconds() + seconds, [](uint64, double) {}));
+	}));
@@ -1,15 +1,30 @@
 #include "OceanTextureManager.h"
 
+#include "BatchedFFTComputeShader.h"
+#include "BatchedFourierComponentsComputeShader.h"
+#include "BatchedInversionComputeShader.h"
 #include "ButterflyTextureComputeShader.h"
+#include "CustomShaders.h"
+#include "DispersionComputeShader.h"
 #include "FFTComputeShader.h"
 #include "FoamComputeShader.h"
 #include "FourierComponentsComputeShader.h"
+#include "HAL/Event.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CoreDelegates.h"
 #include "NoiseComputeShader.h"
+#include "OceanFixedSizeFFT.h"
+#include "OceanFrameArena.h"
+#include "OceanSharedFieldPublisher.h"
 #include "RenderGraphUtils.h"
+#include "RenderTargetPool.h"
 #include "InitialSpectraComputeShader.h"
 #include "InversionComputeShader.h"
 #include "NormalsComputeShader.h"
+#include "PhasorComputeShader.h"
+#include "SpectrumResampleComputeShader.h"
 #include "DSP/AudioFFT.h"
+#include "RenderingThread.h"
 #include "Runtime/Engine/Classes/Engine/TextureRenderTarget2D.h"
 
 
@@ -26,10 +41,16 @@ T reverse(T n, size_t b = sizeof(T) * CHAR_BIT)
 }
 
 
-TArray<int> OceanTextureManager::PrecomputeBitReversedIndices(int N)
+void OceanTextureManager::PrecomputeBitReversedIndices(int N, TArrayView<int> reversedIndices)
 {
-	TArray<int> reversedIndices;
-	reversedIndices.SetNumUninitialized(N);
+	if (const uint16* table = OceanFixedSizeFFT::FindBitReversedIndices(N))
+	{
+		for (int i = 0; i < N; i++)
+		{
+			reversedIndices[i] = table[i];
+		}
+		return;
+	}
 	
 	const unsigned int power = log2(N);
 	
@@ -37,397 +58,1378 @@ TArray<int> OceanTextureManager::PrecomputeBitReversedIndices(int N)
 	{
 		reversedIndices[i] = reverse(i, power);
 	}
+}
+
+
+void OceanTextureManager::SplitTime(double time, float& timeHi, float& timeLo)
+{
+	int exponent;
+	frexp(time, &exponent);
 
-	return reversedIndices;
+	const double quantum = ldexp(1.0, exponent - 12);
+	const double head = floor(time / quantum) * quantum;
+
+	timeHi = (float)head;
+	timeLo = (float)(time - head);
+}
+
+
+OceanTextureManager::OceanTextureManager()
+{
+	// The singleton is never destroyed, so neither is the binding
+	FCoreDelegates::OnEndFrameRT.AddRaw(this, &OceanTextureManager::OnEndFrame_RenderThread);
 }
 
 
 void OceanTextureManager::SetSpectrumParameters(const FSpectrumParameters& spectrumParameters)
 {
-	mSpectrumParameters = spectrumParameters;
+	// The render thread works on its own copy, commands already in flight finish with the old parameters
+	ENQUEUE_RENDER_COMMAND(SetSpectrumParametersCmd)([this, spectrumParameters](FRHICommandListImmediate& rhiCmdList)
+	{
+		mSpectrumParameters = spectrumParameters;
+		mN = spectrumParameters.N;
+
+		// Dispersion depends on L, drop it and force the phasors to be rebuilt. Spectra of other resolutions
+		// are stale too and have to be warmed up again.
+		mDispersionCache.Empty();
+		mInitialSpectraCache.Empty();
+		mWarmResolutions = 0;
+		mPhasorState = FPhasorState();
+	});
 
 	ComputeInitialSpectra(FOnInitialSpectraTexturesReady(), false);
 }
 
 
+void OceanTextureManager::SetPhasorEvolutionParameters(const FPhasorEvolutionParameters& phasorParameters)
+{
+	mPhasorParameters = phasorParameters;
+
+	ENQUEUE_RENDER_COMMAND(ResetPhasorsCmd)([this](FRHICommandListImmediate& rhiCmdList)
+	{
+		mPhasorState = FPhasorState();
+	});
+}
+
+
+void OceanTextureManager::PrewarmResolution(int N)
+{
+	check(FMath::IsPowerOfTwo(N));
+	
+	ENQUEUE_RENDER_COMMAND(PrewarmResolutionCmd)([this, N](FRHICommandListImmediate& rhiCmdList)
+	{
+		GetButterflyTexture_RenderThread(rhiCmdList, N);
+
+		// Resample from the active resolution so the waves both sizes can represent are identical
+		if (!mInitialSpectraCache.Contains(N))
+		{
+			if (!mInitialSpectraCache.Contains(mN))
+			{
+				BuildInitialSpectra_RenderThread(rhiCmdList, mN);
+			}
+			
+			BuildInitialSpectra_RenderThread(rhiCmdList, N, mN);
+		}
+
+		if (!mDispersionCache.Contains(N))
+		{
+			FRDGBuilder rdgBuilder(rhiCmdList);
+			RegisterDispersionTexture(rdgBuilder, N);
+			rdgBuilder.Execute();
+		}
+
+		mWarmResolutions |= 1u << FMath::FloorLog2(N);
+	});
+}
+
+
+void OceanTextureManager::SetResolution(int N)
+{
+	PrewarmResolution(N);
+	
+	// Commands already in flight finish at the old resolution
+	ENQUEUE_RENDER_COMMAND(SetResolutionCmd)([this, N](FRHICommandListImmediate& rhiCmdList)
+	{
+		mN = N;
+	});
+}
+
+
+void OceanTextureManager::SetReadbackOutputs(EOceanOutputs outputs)
+{
+	ENQUEUE_RENDER_COMMAND(SetReadbackOutputsCmd)([this, outputs](FRHICommandListImmediate& rhiCmdList)
+	{
+		mReadbackOutputs = outputs;
+	});
+}
+
+
+void OceanTextureManager::SetSharedFieldPublisher(OceanSharedFieldPublisher* publisher)
+{
+	ENQUEUE_RENDER_COMMAND(SetSharedFieldPublisherCmd)([this, publisher](FRHICommandListImmediate& rhiCmdList)
+	{
+		mSharedFieldPublisher = publisher;
+	});
+}
+
+
+void OceanTextureManager::PollReadback_RenderThread(FRHICommandListImmediate& rhiCmdList)
+{
+	mReadback.GetBackend().CommandList = &rhiCmdList;
+	const bool published = mReadback.Poll();
+	mReadback.GetBackend().CommandList = nullptr;
+
+	if (published && mSharedFieldPublisher)
+	{
+		const TOceanReadbackRing<FOceanRHIReadbackBackend>::FFramePtr frame = mReadback.GetLatest();
+		mSharedFieldPublisher->Publish(frame->Time, frame->N, mSpectrumParameters.L, frame->Axes[0], frame->Axes[1], frame->Axes[2]);
+	}
+}
+
+
+void OceanTextureManager::OnEndFrame_RenderThread()
+{
+	if (mReadback.GetNumInFlight() > 0)
+	{
+		PollReadback_RenderThread(FRHICommandListExecutor::GetImmediateCommandList());
+	}
+}
+
+
+bool OceanTextureManager::IsResolutionWarm(int N) const
+{
+	return (mWarmResolutions.load() & (1u << FMath::FloorLog2(N))) != 0;
+}
+
+
 void OceanTextureManager::ComputeButterfly(FOnButterflyTextureReady onComplete)
 {
-	if (mButterflyTextureCache.Contains(mSpectrumParameters.N))
-		return (void) onComplete.ExecuteIfBound(mButterflyTextureCache[mSpectrumParameters.N]);
+	ENQUEUE_RENDER_COMMAND(ButterflyComputeCmd)([this, onComplete](FRHICommandListImmediate& rhiCmdList)
+	{
+		onComplete.ExecuteIfBound(GetButterflyTexture_RenderThread(rhiCmdList, mN));
+	});
+}
+
+
+TRefCountPtr<IPooledRenderTarget> OceanTextureManager::GetButterflyTexture_RenderThread(FRHICommandListImmediate& rhiCmdList, int N)
+{
+	if (mButterflyTextureCache.Contains(N))
+		return mButterflyTextureCache[N];
+
+	const int width = log2(N);
 	
-	ENQUEUE_RENDER_COMMAND(WaveComputeCmd)([this, onComplete](FRHICommandListImmediate& rhiCmdList) mutable
+	FRDGTextureDesc textureDesc = FRDGTextureDesc::Create2D(
+		FIntPoint(width, N),
+		PF_A32B32G32R32F,
+		FClearValueBinding(),
+		TexCreate_UAV
+	);
+
+	// Specialised sizes already have the whole texture at compile time, upload it instead of dispatching
+	TArray<FVector4f> butterflyTexels;
+	if (OceanFixedSizeFFT::BuildButterflyTexture(N, butterflyTexels))
 	{
-		FRDGBuilder rdgBuilder(rhiCmdList);
+		TRefCountPtr<IPooledRenderTarget> output = AllocatePooledTexture(textureDesc, TEXT("Butterfly_Compute_Out"));
+		rhiCmdList.UpdateTexture2D(output->GetRHI(), 0, FUpdateTextureRegion2D(0, 0, 0, 0, width, N), width * sizeof(FVector4f), (const uint8*)butterflyTexels.GetData());
+
+		return mButterflyTextureCache.Add(N, output);
+	}
+	
+	FRDGBuilder rdgBuilder(rhiCmdList);
+	
+	FButterflyTextureComputeShader::FParameters params;
+	params.N = N;
+
+	// Create butterfly texture on GPU
+	FRDGTextureRef outTextureRef = rdgBuilder.CreateTexture(textureDesc, TEXT("Butterfly_Compute_Out"));
+	FRDGTextureUAVRef outTextureUAV = rdgBuilder.CreateUAV({ outTextureRef });
+	params.ButterflyTexture = outTextureUAV;
+
+	// Upload bit-reversed indices to GPU
+	FRDGBufferDesc bitReversedIndicesBufferDesc = FRDGBufferDesc::CreateBufferDesc(sizeof(int), N);
+	FRDGBufferRef bitReversedIndicesBufferRef = rdgBuilder.CreateBuffer(bitReversedIndicesBufferDesc, TEXT("Butterfly_Compute_BRI_Buffer"));
+	params.BitReversedIndices = rdgBuilder.CreateUAV({ bitReversedIndicesBufferRef, PF_R32_SINT });
+
+	// QueueBufferUpload copies the data, so the arena can be rewound by the next command
+	mRenderArena.Reset();
+	TArrayView<int> bri = mRenderArena.AllocateArray<int>(N);
+	PrecomputeBitReversedIndices(N, bri);
+	rdgBuilder.QueueBufferUpload(bitReversedIndicesBufferRef, bri.GetData(), bri.Num() * sizeof(int));
+
+	// Add compute execution step
+	TShaderMapRef<FButterflyTextureComputeShader> butterflyCompute(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	
+	rdgBuilder.AddPass(
+		RDG_EVENT_NAME("ButterflyComputePass"),
+		&params,
+		ERDGPassFlags::Compute,
+		[&](FRHICommandListImmediate& passRhiCmdList)
+	{	
+		FComputeShaderUtils::Dispatch(passRhiCmdList, butterflyCompute, params,
+		FIntVector(
+			FMath::DivideAndRoundUp(width, NUM_THREADS_PER_GROUP_DIMENSION),
+			FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
+			1)
+		);
+	});
+
+	TRefCountPtr<IPooledRenderTarget> output;
+	rdgBuilder.QueueTextureExtraction(outTextureRef, &output);
+	rdgBuilder.Execute();
+	
+	return mButterflyTextureCache.Add(N, output);
+}
+
+
+void OceanTextureManager::ComputeInitialSpectra(FOnInitialSpectraTexturesReady onComplete, bool useCache)
+{
+	ENQUEUE_RENDER_COMMAND(SpectraComputeCmd)([this, onComplete, useCache](FRHICommandListImmediate& rhiCmdList)
+	{
+		const int N = mN;
+		const FInitialSpectra& spectra = useCache
+			? GetInitialSpectra_RenderThread(rhiCmdList, N)
+			: BuildInitialSpectra_RenderThread(rhiCmdList, N);
 		
-		FButterflyTextureComputeShader::FParameters params;
-		params.N = mSpectrumParameters.N;
-
-		// Create butterfly texture on GPU
-		FRDGTextureDesc textureDesc = FRDGTextureDesc::Create2D(
-			FIntPoint(log2(mSpectrumParameters.N), mSpectrumParameters.N),
-			PF_A32B32G32R32F,
-			FClearValueBinding(),
-			TexCreate_UAV
+		onComplete.ExecuteIfBound(spectra.Positive, spectra.Negative);
+	});
+}
+
+
+const OceanTextureManager::FInitialSpectra& OceanTextureManager::GetInitialSpectra_RenderThread(FRHICommandListImmediate& rhiCmdList, int N)
+{
+	if (const FInitialSpectra* spectra = mInitialSpectraCache.Find(N))
+		return *spectra;
+
+	return BuildInitialSpectra_RenderThread(rhiCmdList, N);
+}
+
+
+const OceanTextureManager::FInitialSpectra& OceanTextureManager::BuildInitialSpectra_RenderThread(FRHICommandListImmediate& rhiCmdList, int N, int sourceN)
+{
+	TShaderMapRef<FNoiseComputeShader> noiseComputeShader (GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	FRDGBuilder rdgBuilder(rhiCmdList);
+
+	// Compute noise textures (R,G,B, and A are each individual random 0-1 floats)
+	FRDGTextureDesc textureDesc = FRDGTextureDesc::Create2D(
+		FIntPoint(N, N),
+		PF_A32B32G32R32F,
+		FClearValueBinding(),
+		TexCreate_UAV
+	);
+	
+	FRDGTextureRef outNoiseRef = rdgBuilder.CreateTexture(textureDesc, TEXT("Noise_Compute_Out"));
+	FRDGTextureUAVRef outNoiseUAV = rdgBuilder.CreateUAV({ outNoiseRef });
+	FNoiseComputeShader::FParameters noiseComputeParams;
+	noiseComputeParams.Output = outNoiseUAV;
+
+	rdgBuilder.AddPass(
+		RDG_EVENT_NAME("NoiseComputePass"),
+		&noiseComputeParams,
+		ERDGPassFlags::Compute,
+		[&](FRHICommandListImmediate& passRhiCmdList)
+	{	
+		FComputeShaderUtils::Dispatch(passRhiCmdList, noiseComputeShader, noiseComputeParams,
+		FIntVector(
+			FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
+			FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
+			1)
 		);
-		FRDGTextureRef outTextureRef = rdgBuilder.CreateTexture(textureDesc, TEXT("Butterfly_Compute_Out"));
-        FRDGTextureUAVRef outTextureUAV = rdgBuilder.CreateUAV({ outTextureRef });
-		params.ButterflyTexture = outTextureUAV;
+	});
+	
+	// Compute initial spectra
+	TShaderMapRef<FInitialSpectraComputeShader> spectraComputeShader (GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	FInitialSpectraComputeShader::FParameters spectraComputeParams;
+	spectraComputeParams.N = N;
+	spectraComputeParams.L = mSpectrumParameters.L;
+	spectraComputeParams.A = mSpectrumParameters.A;
+	spectraComputeParams.WindDirection = mSpectrumParameters.WindDirection;
+	spectraComputeParams.WindSpeed = mSpectrumParameters.WindSpeed;
+	spectraComputeParams.Noise = outNoiseUAV;
+
+	FRDGTextureRef outNegativeSpectrum = rdgBuilder.CreateTexture(textureDesc, TEXT("NegativeSpectrum_Compute_Out"));
+	FRDGTextureUAVRef outNegativeSpectrumUAV = rdgBuilder.CreateUAV({ outNegativeSpectrum });
+	spectraComputeParams.NegativeSpectrum = outNegativeSpectrumUAV;
 
-		// Upload bit-reversed indices to GPU
-		FRDGBufferDesc bitReversedIndicesBufferDesc = FRDGBufferDesc::CreateBufferDesc(sizeof(int), mSpectrumParameters.N);
-		FRDGBufferRef bitReversedIndicesBufferRef = rdgBuilder.CreateBuffer(bitReversedIndicesBufferDesc, TEXT("Butterfly_Compute_BRI_Buffer"));
-		params.BitReversedIndices = rdgBuilder.CreateUAV({ bitReversedIndicesBufferRef, PF_R32_SINT });
+	FRDGTextureRef outPositiveSpectrum = rdgBuilder.CreateTexture(textureDesc, TEXT("PositiveSpectrum_Compute_Out"));
+	FRDGTextureUAVRef outPositiveSpectrumUAV = rdgBuilder.CreateUAV({ outPositiveSpectrum });
+	spectraComputeParams.PositiveSpectrum = outPositiveSpectrumUAV;
+
+	rdgBuilder.AddPass(
+		RDG_EVENT_NAME("InitialSpectraComputePass"),
+		&spectraComputeParams,
+		ERDGPassFlags::Compute,
+		[&](FRHICommandListImmediate& passRhiCmdList)
+	{	
+		FComputeShaderUtils::Dispatch(passRhiCmdList, spectraComputeShader, spectraComputeParams,
+		FIntVector(
+			FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
+			FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
+			1)
+		);
+	});
 
-		TArray<int> bri = PrecomputeBitReversedIndices(mSpectrumParameters.N);
-		rdgBuilder.QueueBufferUpload(bitReversedIndicesBufferRef, bri.GetData(), bri.Num() * sizeof(int));
+	FInitialSpectra spectra;
 
-		// Add compute execution step
-		TShaderMapRef<FButterflyTextureComputeShader> butterflyCompute(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	// The inversion divides by N^2, so a spectrum derived from sourceN is rescaled by (N / sourceN)^2 on top of the
+	// source's own scale to keep the heights. Fresh bins outside the overlap get the same overall scale.
+	if (const FInitialSpectra* source = sourceN != N ? mInitialSpectraCache.Find(sourceN) : nullptr)
+	{
+		const float sourceScale = FMath::Square((float)N / sourceN);
+		spectra.Scale = source->Scale * sourceScale;
 		
+		FSpectrumResampleComputeShader::FParameters* resampleParams = rdgBuilder.AllocParameters<FSpectrumResampleComputeShader::FParameters>();
+		resampleParams->SourcePositiveSpectrum = rdgBuilder.CreateUAV({ rdgBuilder.RegisterExternalTexture(source->Positive) });
+		resampleParams->SourceNegativeSpectrum = rdgBuilder.CreateUAV({ rdgBuilder.RegisterExternalTexture(source->Negative) });
+		resampleParams->PositiveSpectrum = outPositiveSpectrumUAV;
+		resampleParams->NegativeSpectrum = outNegativeSpectrumUAV;
+		resampleParams->SourceN = sourceN;
+		resampleParams->N = N;
+		resampleParams->SourceScale = sourceScale;
+		resampleParams->Scale = spectra.Scale;
+
+		TShaderMapRef<FSpectrumResampleComputeShader> resampleCompute(GetGlobalShaderMap(GMaxRHIFeatureLevel));
 		rdgBuilder.AddPass(
-			RDG_EVENT_NAME("ButterflyComputePass"),
-			&params,
+			RDG_EVENT_NAME("SpectrumResampleComputePass"),
+			resampleParams,
 			ERDGPassFlags::Compute,
-			[&](FRHICommandListImmediate& passRhiCmdList)
-		{	
-			FComputeShaderUtils::Dispatch(passRhiCmdList, butterflyCompute, params,
+			[resampleParams, resampleCompute, N](FRHICommandListImmediate& passRhiCmdList)
+		{
+			FComputeShaderUtils::Dispatch(passRhiCmdList, resampleCompute, *resampleParams,
 			FIntVector(
-				FMath::DivideAndRoundUp((int)(log2(mSpectrumParameters.N)), NUM_THREADS_PER_GROUP_DIMENSION),
-				FMath::DivideAndRoundUp(mSpectrumParameters.N, NUM_THREADS_PER_GROUP_DIMENSION),
+				FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
+				FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
 				1)
 			);
 		});
+	}
+	
+	rdgBuilder.QueueTextureExtraction(outNegativeSpectrum, &spectra.Negative);
+	rdgBuilder.QueueTextureExtraction(outPositiveSpectrum, &spectra.Positive);
+	rdgBuilder.Execute();
+
+	return mInitialSpectraCache.Add(N, spectra);
+}
+
+
+void OceanTextureManager::BeginSimulationTiming_RenderThread(FRHICommandListImmediate& rhiCmdList)
+{
+	if (!mTimestampQueryPool.IsValid())
+	{
+		mTimestampQueryPool = RHICreateRenderQueryPool(RQT_AbsoluteTime);
+	}
+
+	// The GPU is far behind, skip this frame rather than queueing more queries
+	if (mNumPendingTimings == MaxPendingTimings || mOpenTimestamp.IsValid())
+		return;
+	
+	mOpenTimestamp = mTimestampQueryPool->AllocateQuery();
+	rhiCmdList.EndRenderQuery(mOpenTimestamp.GetQuery());
+}
 
-		TRefCountPtr<IPooledRenderTarget> output;
-		rdgBuilder.QueueTextureExtraction(outTextureRef, &output);
-		rdgBuilder.Execute();
+
+void OceanTextureManager::EndSimulationTiming_RenderThread(FRHICommandListImmediate& rhiCmdList)
+{
+	if (mOpenTimestamp.IsValid())
+	{
+		FPendingTiming& timing = mPendingTimings[(mFirstPendingTiming + mNumPendingTimings) % MaxPendingTimings];
+		timing.Begin = MoveTemp(mOpenTimestamp);
+		timing.End = mTimestampQueryPool->AllocateQuery();
+		rhiCmdList.EndRenderQuery(timing.End.GetQuery());
 		
-		mButterflyTextureCache.Add(mSpectrumParameters.N, output);
-		onComplete.ExecuteIfBound(output);
+		mOpenTimestamp = FRHIPooledRenderQuery();
+		mNumPendingTimings++;
+	}
+
+	// Collect whatever has finished without waiting on the GPU
+	while (mNumPendingTimings > 0)
+	{
+		FPendingTiming& timing = mPendingTimings[mFirstPendingTiming];
+
+		uint64 beginMicroseconds, endMicroseconds;
+		if (!RHIGetRenderQueryResult(timing.Begin.GetQuery(), beginMicroseconds, false) ||
+			!RHIGetRenderQueryResult(timing.End.GetQuery(), endMicroseconds, false))
+			break;
+
+		mLastSimulationGpuMs = (endMicroseconds - beginMicroseconds) / 1000.0f;
+		
+		timing = FPendingTiming();
+		mFirstPendingTiming = (mFirstPendingTiming + 1) % MaxPendingTimings;
+		mNumPendingTimings--;
+	}
+}
+
+
+FRDGTextureRef OceanTextureManager::RegisterDispersionTexture(FRDGBuilder& rdgBuilder, int N)
+{
+	if (mDispersionCache.Contains(N))
+		return rdgBuilder.RegisterExternalTexture(mDispersionCache[N]);
+	
+	FRDGTextureDesc textureDesc = FRDGTextureDesc::Create2D(
+		FIntPoint(N, N),
+		PF_A32B32G32R32F,
+		FClearValueBinding(),
+		TexCreate_UAV
+	);
+	FRDGTextureRef dispersionRef = rdgBuilder.CreateTexture(textureDesc, TEXT("Dispersion_Compute_Out"));
+	
+	FDispersionComputeShader::FParameters* dispersionParams = rdgBuilder.AllocParameters<FDispersionComputeShader::FParameters>();
+	dispersionParams->N = N;
+	dispersionParams->L = mSpectrumParameters.L;
+	dispersionParams->Dispersion = rdgBuilder.CreateUAV({ dispersionRef });
+	
+	TShaderMapRef<FDispersionComputeShader> dispersionCompute(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	rdgBuilder.AddPass(
+		RDG_EVENT_NAME("DispersionComputePass"),
+		dispersionParams,
+		ERDGPassFlags::Compute,
+		[dispersionParams, dispersionCompute, N](FRHICommandListImmediate& passRhiCmdList)
+	{
+		FComputeShaderUtils::Dispatch(passRhiCmdList, dispersionCompute, *dispersionParams,
+		FIntVector(
+			FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
+			FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
+			1)
+		);
 	});
+	
+	rdgBuilder.QueueTextureExtraction(dispersionRef, &mDispersionCache.Add(N));
+	return dispersionRef;
 }
 
 
-void OceanTextureManager::ComputeInitialSpectra(FOnInitialSpectraTexturesReady onComplete, bool useCache)
+bool OceanTextureManager::NeedsDisplacementAxis(EOceanOutputs outputs, int axis)
+{
+	if (axis == 1)
+		return EnumHasAnyFlags(outputs, EOceanOutputs::Height);
+	
+	return EnumHasAnyFlags(outputs, EOceanOutputs::Choppiness | EOceanOutputs::Normals | EOceanOutputs::Foam);
+}
+
+
+void OceanTextureManager::GetDisplacementChannels(EOceanOutputs outputs, bool (&computed)[5], bool (&written)[5])
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		computed[axis] = NeedsDisplacementAxis(outputs, axis);
+	}
+	computed[3] = EnumHasAnyFlags(outputs, EOceanOutputs::Foam);
+	computed[4] = EnumHasAnyFlags(outputs, EOceanOutputs::Normals | EOceanOutputs::Foam);
+
+	const bool choppiness = EnumHasAnyFlags(outputs, EOceanOutputs::Choppiness);
+	written[0] = choppiness;
+	written[1] = computed[1];
+	written[2] = choppiness;
+	written[3] = computed[3];
+	written[4] = EnumHasAnyFlags(outputs, EOceanOutputs::Normals);
+}
+
+
+void OceanTextureManager::ComputeFourierComponents(double time, FOnFourierComponentsReady onComplete, EOceanOutputs outputs, FOceanCancellationToken cancellation)
 {
-	if (useCache && mInitialSpectraCache.Contains(mSpectrumParameters.N))
-		return (void) onComplete.ExecuteIfBound(mInitialSpectraCache[mSpectrumParameters.N].first, mInitialSpectraCache[mSpectrumParameters.N].second);
+	if (outputs == EOceanOutputs::None)
+		return (void) onComplete.ExecuteIfBound(FFourierComponents());
 	
-	ENQUEUE_RENDER_COMMAND(SpectraComputeCmd)([this, onComplete](FRHICommandListImmediate& rhiCmdList) mutable 
+	ENQUEUE_RENDER_COMMAND(FourierComponentsComputeCmd)([this, onComplete, time, outputs, cancellation, phasorParameters = mPhasorParameters](FRHICommandListImmediate& rhiCmdList)
+	{
+		if (cancellation.IsCancelled())
+			return (void) onComplete.ExecuteIfBound(FFourierComponents());
+
+		onComplete.ExecuteIfBound(ComputeFourierComponents_RenderThread(rhiCmdList, time, outputs, phasorParameters));
+	});
+}
+
+
+OceanTextureManager::FFourierComponents OceanTextureManager::ComputeFourierComponents_RenderThread(FRHICommandListImmediate& rhiCmdList, double time, EOceanOutputs outputs, const FPhasorEvolutionParameters& phasorParameters)
+{
+	const int N = mN;
+	const FInitialSpectra& spectra = GetInitialSpectra_RenderThread(rhiCmdList, N);
+
+	FRDGBuilder rdgBuilder(rhiCmdList);
+
+	FFourierComponentsComputeShader::FParameters params;
+	params.N = mN;
+	params.L = mSpectrumParameters.L;
+	params.t = (float)time;
+
+	// Create height texture on GPU
+	FRDGTextureDesc textureDesc = FRDGTextureDesc::Create2D(
+		FIntPoint(mN, mN),
+		PF_A32B32G32R32F,
+		FClearValueBinding(),
+		TexCreate_UAV
+	);
+
+	FFourierComponentsComputeShader::FPermutationDomain permutationVector;
+	permutationVector.Set<FFourierComponentsComputeShader::FUsePhasors>(phasorParameters.bEnabled);
+	permutationVector.Set<FFourierComponentsComputeShader::FOutputHeight>(NeedsDisplacementAxis(outputs, 1));
+	permutationVector.Set<FFourierComponentsComputeShader::FOutputHorizontal>(NeedsDisplacementAxis(outputs, 0));
+
+	if (phasorParameters.bEnabled)
 	{
-		TShaderMapRef<FNoiseComputeShader> noiseComputeShader (GetGlobalShaderMap(GMaxRHIFeatureLevel));
-		FRDGBuilder rdgBuilder(rhiCmdList);
+		FRDGTextureRef dispersionRef = RegisterDispersionTexture(rdgBuilder, N);
+
+		// Decide whether to step the phasors or rebuild them from the double precision time
+		bool reseed = !mPhasorState.Phasors.IsValid() || mPhasorState.N != N;
+		int steps = 0;
+
+		if (!reseed)
+		{
+			steps = FMath::FloorToInt((time - mPhasorState.Time) / phasorParameters.TimeStep);
+			reseed = steps < 0
+				|| steps > phasorParameters.MaxStepsPerFrame
+				|| mPhasorState.StepsSinceReseed + steps > phasorParameters.RenormalizeInterval;
+		}
+
+		if (reseed)
+		{
+			mPhasorState.N = N;
+			mPhasorState.Time = time;
+			mPhasorState.StepsSinceReseed = 0;
+		}
+		else
+		{
+			mPhasorState.Time += steps * (double)phasorParameters.TimeStep;
+			mPhasorState.StepsSinceReseed += steps;
+		}
+
+		FRDGTextureRef phasorsRef;
+		if (reseed)
+		{
+			phasorsRef = rdgBuilder.CreateTexture(textureDesc, TEXT("Phasors_Compute_Out"));
+			rdgBuilder.QueueTextureExtraction(phasorsRef, &mPhasorState.Phasors);
+		}
+		else
+		{
+			phasorsRef = rdgBuilder.RegisterExternalTexture(mPhasorState.Phasors);
+		}
+
+		FRDGTextureUAVRef dispersionUAV = rdgBuilder.CreateUAV({ dispersionRef });
+		FRDGTextureUAVRef phasorsUAV = rdgBuilder.CreateUAV({ phasorsRef });
+
+		if (reseed || steps > 0)
+		{
+			FPhasorComputeShader::FParameters* phasorParams = rdgBuilder.AllocParameters<FPhasorComputeShader::FParameters>();
+			phasorParams->Dispersion = dispersionUAV;
+			phasorParams->Phasors = phasorsUAV;
+			SplitTime(mPhasorState.Time, phasorParams->TimeHi, phasorParams->TimeLo);
+			phasorParams->TimeStep = phasorParameters.TimeStep;
+			phasorParams->Steps = steps;
+			phasorParams->Reseed = reseed ? 1 : 0;
+
+			TShaderMapRef<FPhasorComputeShader> phasorCompute(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+			rdgBuilder.AddPass(
+				RDG_EVENT_NAME("PhasorComputePass"),
+				phasorParams,
+				ERDGPassFlags::Compute,
+				[phasorParams, phasorCompute, N](FRHICommandListImmediate& passRhiCmdList)
+			{
+				FComputeShaderUtils::Dispatch(passRhiCmdList, phasorCompute, *phasorParams,
+				FIntVector(
+					FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
+					FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
+					1)
+				);
+			});
+		}
+
+		params.Dispersion = dispersionUAV;
+		params.Phasors = phasorsUAV;
+	}
 
-		// Compute noise textures (R,G,B, and A are each individual random 0-1 floats)
-		FRDGTextureDesc textureDesc = FRDGTextureDesc::Create2D(
-			FIntPoint(mSpectrumParameters.N, mSpectrumParameters.N),
-			PF_A32B32G32R32F,
-			FClearValueBinding(),
-			TexCreate_UAV
+	// Channels left out of outputs get no texture at all. The pooled textures stay reserved for as long as
+	// output holds them, i.e. until the FFT of this request is done with them.
+	bool computed[5], written[5];
+	GetDisplacementChannels(outputs, computed, written);
+
+	FFourierComponents output;
+	mResourcePool.AcquireFourierComponents(mN, textureDesc.Format, computed, output.Components);
+
+	const TCHAR* fourierComponentsNames[] { TEXT("FourierComponents_X_Out"), TEXT("FourierComponents_Y_Out"), TEXT("FourierComponents_Z_Out") };
+	FRDGTextureUAVRef* fourierComponentsUAVs[] { &params.FourierComponentsX, &params.FourierComponentsY, &params.FourierComponentsZ };
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (!computed[axis])
+			continue;
+
+		*fourierComponentsUAVs[axis] = rdgBuilder.CreateUAV({ rdgBuilder.RegisterExternalTexture(output.Components[axis], fourierComponentsNames[axis]) });
+	}
+
+	FRDGTextureRef positiveSpectrumRef = rdgBuilder.RegisterExternalTexture(spectra.Positive);
+	params.PositiveInitialSpectrum = rdgBuilder.CreateUAV({ positiveSpectrumRef });
+
+	FRDGTextureRef negativeSpectrumRef = rdgBuilder.RegisterExternalTexture(spectra.Negative);
+	params.NegativeInitialSpectrum = rdgBuilder.CreateUAV({ negativeSpectrumRef });
+
+	// Add compute execution step
+	TShaderMapRef<FFourierComponentsComputeShader> fourierComponentsCompute(GetGlobalShaderMap(GMaxRHIFeatureLevel), permutationVector);
+
+	rdgBuilder.AddPass(
+		RDG_EVENT_NAME("FourierComponentsComputePass"),
+		&params,
+		ERDGPassFlags::Compute,
+		[&](FRHICommandListImmediate& passRhiCmdList)
+	{	
+		FComputeShaderUtils::Dispatch(passRhiCmdList, fourierComponentsCompute, params,
+		FIntVector(
+			FMath::DivideAndRoundUp(mN, NUM_THREADS_PER_GROUP_DIMENSION),
+			FMath::DivideAndRoundUp(mN, NUM_THREADS_PER_GROUP_DIMENSION),
+			1)
 		);
-		
-		FRDGTextureRef outNoiseRef = rdgBuilder.CreateTexture(textureDesc, TEXT("Noise_Compute_Out"));
-        FRDGTextureUAVRef outNoiseUAV = rdgBuilder.CreateUAV({ outNoiseRef });
-		FNoiseComputeShader::FParameters noiseComputeParams;
-		noiseComputeParams.Output = outNoiseUAV;
+	});
+
+	rdgBuilder.Execute();
+
+	return output;
+}
+
+
+void OceanTextureManager::ComputeDisplacement(double time, FOnDisplacementFieldReady onComplete, UTextureRenderTarget2D* displacementOutXTarget, UTextureRenderTarget2D* displacementOutYTarget, UTextureRenderTarget2D* displacementOutZTarget, UTextureRenderTarget2D* foamOutTarget, EOceanOutputs outputs)
+{
+	const TSharedRef<FDisplacementRequest>& request = AcquireDisplacementRequest();
+	request->Time = time;
+	request->Outputs = outputs;
+	request->Targets = { displacementOutXTarget, displacementOutYTarget, displacementOutZTarget, foamOutTarget };
+	request->OnDisplacementFieldReady = MoveTemp(onComplete);
+
+	EnqueueDisplacement(request);
+}
+
+
+TOceanFuture<OceanTextureManager::FDisplacementResult> OceanTextureManager::Displacement(double time, const FDisplacementTargets& targets, EOceanOutputs outputs, int channel)
+{
+	TOceanPromise<FDisplacementResult> promise;
+
+	// The channel's previous request is stale now, it is dropped unless it already reached the GPU
+	if (const FOceanCancellationToken* previous = mDisplacementChannels.Find(channel))
+	{
+		previous->Cancel();
+	}
+	mDisplacementChannels.Add(channel, promise.GetCancellationToken());
+
+	const TSharedRef<FDisplacementRequest>& request = AcquireDisplacementRequest();
+	request->Time = time;
+	request->Outputs = outputs;
+	request->Targets = targets;
+	request->Cancellation = promise.GetCancellationToken();
+	request->Promise = promise;
 
+	EnqueueDisplacement(request);
+
+	return promise.GetFuture();
+}
+
+
+void OceanTextureManager::FDisplacementRequest::Complete(const FDisplacementResult& result)
+{
+	if (Promise.IsSet())
+	{
+		Promise->SetValue(result);
+	}
+	else
+	{
+		OnDisplacementFieldReady.ExecuteIfBound(result.Displacement[1]);
+	}
+
+	// Whatever the callbacks hold on to is released now rather than when the request is reused
+	OnDisplacementFieldReady.Unbind();
+	Promise.Reset();
+}
+
+
+const TSharedRef<OceanTextureManager::FDisplacementRequest>& OceanTextureManager::AcquireDisplacementRequest()
+{
+	// Requests the render thread is done with are only referenced from here
+	for (const TSharedRef<FDisplacementRequest>& request : mDisplacementRequestPool)
+	{
+		if (request.GetSharedReferenceCount() == 1)
+		{
+			*request = FDisplacementRequest();
+			return request;
+		}
+	}
+
+	return mDisplacementRequestPool.Add_GetRef(MakeShared<FDisplacementRequest>());
+}
+
+
+void OceanTextureManager::EnqueueDisplacement(const TSharedRef<FDisplacementRequest>& request)
+{
+	if (request->Outputs == EOceanOutputs::None)
+	{
+		FDisplacementResult result;
+		result.Time = request->Time;
+		return request->Complete(result);
+	}
+	
+	request->PhasorParameters = mPhasorParameters;
+
+	// One command that only shares the pooled request, so once warm a frame allocates no closures of its own
+	ENQUEUE_RENDER_COMMAND(DisplacementComputeCmd)([this, request](FRHICommandListImmediate& rhiCmdList)
+	{
+		ComputeDisplacement_RenderThread(rhiCmdList, *request);
+	});
+}
+
+
+void OceanTextureManager::ComputeDisplacement_RenderThread(FRHICommandListImmediate& rhiCmdList, FDisplacementRequest& request)
+{
+	const EOceanOutputs outputs = request.Outputs;
+
+	FDisplacementResult result;
+	result.Time = request.Time;
+	
+	if (request.Cancellation.IsCancelled())
+	{
+		result.bCancelled = true;
+		return request.Complete(result);
+	}
+
+	// Everything up to the copies into the targets is timed on the GPU, see GetLastSimulationGpuMs
+	BeginSimulationTiming_RenderThread(rhiCmdList);
+
+	const int N = mN;
+	FFourierComponents fourierComponents = ComputeFourierComponents_RenderThread(rhiCmdList, request.Time, outputs, request.PhasorParameters);
+	const TRefCountPtr<IPooledRenderTarget> butterflyTexture = GetButterflyTexture_RenderThread(rhiCmdList, N);
+
+	FRDGBuilder rdgBuilder(rhiCmdList);
+	TShaderMapRef<FFFTComputeShader> fftCompute(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	const EPixelFormat format = PF_A32B32G32R32F;
+
+	FRDGTextureRef butterflyRef = rdgBuilder.RegisterExternalTexture(butterflyTexture);
+	FRDGTextureUAVRef butterflyTextureUAV = rdgBuilder.CreateUAV({butterflyRef});
+
+	bool computed[5], written[5];
+	GetDisplacementChannels(outputs, computed, written);
+	const bool computeFoam = computed[3];
+	const bool computeNormals = computed[4];
+
+	// Outputs go straight into targets that allow it, the rest into pooled textures copied out at the end
+	UTextureRenderTarget2D* const targets[] { request.Targets.X, request.Targets.Y, request.Targets.Z, request.Targets.Foam, request.Targets.Normals };
+	const TOceanResourcePool<FOceanRHIResourceBackend>::FOutputs frameOutputs = mResourcePool.BeginOutputs(N, format, targets, computed, written);
+	TRefCountPtr<IPooledRenderTarget>* outputTextures[] { &result.Displacement[0], &result.Displacement[1], &result.Displacement[2], &result.Foam, &result.Normals };
+
+	auto registerOutput = [&](int channel, const TCHAR* name)
+	{
+		*outputTextures[channel] = frameOutputs.Direct[channel]
+			? CreateRenderTarget(frameOutputs.Targets[channel]->GetRenderTargetResource()->GetTextureRHI(), name)
+			: frameOutputs.Intermediates[channel];
+		return rdgBuilder.RegisterExternalTexture(*outputTextures[channel], name);
+	};
+
+	const TCHAR* displacementNames[] { TEXT("Displacement_OutX"), TEXT("Displacement_OutY"), TEXT("Displacement_OutZ") };
+	FRDGTextureRef displacementTextures[] { nullptr, nullptr, nullptr };
+
+	FRDGTextureUAVRef displacementTexturesUAV[] { nullptr, nullptr, nullptr };
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (!computed[axis])
+			continue;
+
+		displacementTextures[axis] = registerOutput(axis, displacementNames[axis]);
+
+		FRDGTextureRef fourierComponentsRef = rdgBuilder.RegisterExternalTexture(fourierComponents.Components[axis]);
+		FRDGTextureUAVRef pingpong0UAV = rdgBuilder.CreateUAV({fourierComponentsRef});
+
+		FRDGTextureRef pingPong1Texture = rdgBuilder.RegisterExternalTexture(frameOutputs.PingPong[axis], TEXT("FFT_PingPong1_Out"));
+		FRDGTextureUAVRef pingPong1Texture_UAV = rdgBuilder.CreateUAV({ pingPong1Texture });
+		FRDGTextureUAVRef pingpong1UAV = pingPong1Texture_UAV;
+
+		enum class FFTDirection { Horizontal, Vertical };
+		const int numStages = log2(mN);
+		int pingpong = 0;
+
+		for (auto direction: { FFTDirection::Horizontal, FFTDirection::Vertical })
+		{
+			for (int i = 0; i < numStages; i++)
+			{
+				FFFTComputeShader::FParameters* params = rdgBuilder.AllocParameters<FFFTComputeShader::FParameters>();
+				params->direction = (int)direction;
+				params->pingpong0 = pingpong0UAV;
+				params->pingpong1 = pingpong1UAV;
+				params->stage = i;
+				params->pingpong = pingpong % 2;
+				params->butterflyTexture = butterflyTextureUAV;
+				pingpong++;
+
+				// Add compute execution step
+				rdgBuilder.AddPass(
+					RDG_EVENT_NAME("FFTComputePass"),
+					params,
+					ERDGPassFlags::Compute,
+					[fftCompute, params, this](FRHICommandListImmediate& passRhiCmdList)
+				{	
+					FComputeShaderUtils::Dispatch(passRhiCmdList, fftCompute, *params,
+					FIntVector(
+						FMath::DivideAndRoundUp(mN, NUM_THREADS_PER_GROUP_DIMENSION),
+						FMath::DivideAndRoundUp(mN, NUM_THREADS_PER_GROUP_DIMENSION),
+						1)
+					);
+				});
+			}
+		}
+
+		FInversionComputeShader::FParameters* inversionParams = rdgBuilder.AllocParameters<FInversionComputeShader::FParameters>();
+		inversionParams->pingpong0 = pingpong0UAV;
+		inversionParams->pingpong1 = pingpong1UAV;
+		inversionParams->N = mN;
+		inversionParams->pingpong = pingpong % 2;
+		inversionParams->displacement = displacementTexturesUAV[axis] = rdgBuilder.CreateUAV({ displacementTextures[axis] });
+
+		TShaderMapRef<FInversionComputeShader> inversionCompute (GetGlobalShaderMap(GMaxRHIFeatureLevel));
 		rdgBuilder.AddPass(
-            RDG_EVENT_NAME("NoiseComputePass"),
-            &noiseComputeParams,
-            ERDGPassFlags::Compute,
-            [&](FRHICommandListImmediate& passRhiCmdList)
-        {	
-            FComputeShaderUtils::Dispatch(passRhiCmdList, noiseComputeShader, noiseComputeParams,
-            FIntVector(
-            	FMath::DivideAndRoundUp(mSpectrumParameters.N, NUM_THREADS_PER_GROUP_DIMENSION),
-            	FMath::DivideAndRoundUp(mSpectrumParameters.N, NUM_THREADS_PER_GROUP_DIMENSION),
-            	1)
-            );
-        });
-		
-		// Compute initial spectra
-		TShaderMapRef<FInitialSpectraComputeShader> spectraComputeShader (GetGlobalShaderMap(GMaxRHIFeatureLevel));
-		FInitialSpectraComputeShader::FParameters spectraComputeParams;
-		spectraComputeParams.N = mSpectrumParameters.N;
-		spectraComputeParams.L = mSpectrumParameters.L;
-		spectraComputeParams.A = mSpectrumParameters.A;
-		spectraComputeParams.WindDirection = mSpectrumParameters.WindDirection;
-		spectraComputeParams.WindSpeed = mSpectrumParameters.WindSpeed;
-		spectraComputeParams.Noise = outNoiseUAV;
-
-		FRDGTextureRef outNegativeSpectrum = rdgBuilder.CreateTexture(textureDesc, TEXT("NegativeSpectrum_Compute_Out"));
-		FRDGTextureUAVRef outNegativeSpectrumUAV = rdgBuilder.CreateUAV({ outNegativeSpectrum });
-		spectraComputeParams.NegativeSpectrum = outNegativeSpectrumUAV;
-
-		FRDGTextureRef outPositiveSpectrum = rdgBuilder.CreateTexture(textureDesc, TEXT("PositiveSpectrum_Compute_Out"));
-		FRDGTextureUAVRef outPositiveSpectrumUAV = rdgBuilder.CreateUAV({ outPositiveSpectrum });
-		spectraComputeParams.PositiveSpectrum = outPositiveSpectrumUAV;
+			RDG_EVENT_NAME("InversionComputePass"),
+			inversionParams,
+			ERDGPassFlags::Compute,
+			[inversionParams, inversionCompute, this](FRHICommandListImmediate& passRhiCmdList)
+		{	
+			FComputeShaderUtils::Dispatch(passRhiCmdList, inversionCompute, *inversionParams,
+			FIntVector(
+				FMath::DivideAndRoundUp(mN, NUM_THREADS_PER_GROUP_DIMENSION),
+				FMath::DivideAndRoundUp(mN, NUM_THREADS_PER_GROUP_DIMENSION),
+				1)
+			);
+		});
+	}
 
+	if (computeNormals)
+	{
+		// Without a Normals target (e.g. for Foam alone) they go into a pooled texture that isn't copied anywhere
+		FRDGTextureRef normals = registerOutput(4, TEXT("Normals_Out"));
+		FNormalsComputeShader::FParameters* normalsParams = rdgBuilder.AllocParameters<FNormalsComputeShader::FParameters>();
+		normalsParams->displacementX = displacementTexturesUAV[0];
+		normalsParams->displacementY = displacementTexturesUAV[2];
+		normalsParams->normals = rdgBuilder.CreateUAV({ normals });
+
+		TShaderMapRef<FNormalsComputeShader> normalsCompute (GetGlobalShaderMap(GMaxRHIFeatureLevel));
 		rdgBuilder.AddPass(
-			RDG_EVENT_NAME("InitialSpectraComputePass"),
-			&spectraComputeParams,
+			RDG_EVENT_NAME("NormalsComputePass"),
+			normalsParams,
 			ERDGPassFlags::Compute,
-			[&](FRHICommandListImmediate& passRhiCmdList)
+			[normalsParams, normalsCompute, this](FRHICommandListImmediate& passRhiCmdList)
 		{	
-			FComputeShaderUtils::Dispatch(passRhiCmdList, spectraComputeShader, spectraComputeParams,
+			FComputeShaderUtils::Dispatch(passRhiCmdList, normalsCompute, *normalsParams,
 			FIntVector(
-				FMath::DivideAndRoundUp(mSpectrumParameters.N, NUM_THREADS_PER_GROUP_DIMENSION),
-				FMath::DivideAndRoundUp(mSpectrumParameters.N, NUM_THREADS_PER_GROUP_DIMENSION),
+				FMath::DivideAndRoundUp(mN, NUM_THREADS_PER_GROUP_DIMENSION),
+				FMath::DivideAndRoundUp(mN, NUM_THREADS_PER_GROUP_DIMENSION),
 				1)
 			);
 		});
-		
-		TRefCountPtr<IPooledRenderTarget> negativeSpectrumOut;
-		TRefCountPtr<IPooledRenderTarget> positiveSpectrumOut;
-		rdgBuilder.QueueTextureExtraction(outNegativeSpectrum, &negativeSpectrumOut);
-		rdgBuilder.QueueTextureExtraction(outPositiveSpectrum, &positiveSpectrumOut);
-		rdgBuilder.Execute();
-
-		mInitialSpectraCache.Add(mSpectrumParameters.N, { positiveSpectrumOut, negativeSpectrumOut });
-		onComplete.ExecuteIfBound(positiveSpectrumOut, negativeSpectrumOut);
-	});
+
+		if (computeFoam)
+		{
+			FRDGTextureRef foamTexture = registerOutput(3, TEXT("Foam_Out"));
+			FFoamComputeShader::FParameters* foamParams = rdgBuilder.AllocParameters<FFoamComputeShader::FParameters>();
+			foamParams->normals = normalsParams->normals;
+			foamParams->foam = rdgBuilder.CreateUAV({ foamTexture });
+
+			TShaderMapRef<FFoamComputeShader> foamCompute (GetGlobalShaderMap(GMaxRHIFeatureLevel));
+			rdgBuilder.AddPass(
+				RDG_EVENT_NAME("FoamComputePass"),
+				foamParams,
+				ERDGPassFlags::Compute,
+				[foamParams, foamCompute, this](FRHICommandListImmediate& passRhiCmdList)
+			{	
+				FComputeShaderUtils::Dispatch(passRhiCmdList, foamCompute, *foamParams,
+				FIntVector(
+					FMath::DivideAndRoundUp(mN, NUM_THREADS_PER_GROUP_DIMENSION),
+					FMath::DivideAndRoundUp(mN, NUM_THREADS_PER_GROUP_DIMENSION),
+					1)
+				);
+			});
+		}
+	}
+
+	rdgBuilder.Execute();
+
+	EndSimulationTiming_RenderThread(rhiCmdList);
+
+	mResourcePool.GetBackend().CommandList = &rhiCmdList;
+	mResourcePool.FinishOutputs(frameOutputs);
+	mResourcePool.GetBackend().CommandList = nullptr;
+
+	if (mReadbackOutputs != EOceanOutputs::None)
+	{
+		FOceanRHIReadbackBackend::FSource readbackSource;
+		bool anyAxis = false;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const bool wanted = EnumHasAnyFlags(mReadbackOutputs, axis == 1 ? EOceanOutputs::Height : EOceanOutputs::Choppiness);
+			readbackSource.Axes[axis] = wanted && result.Displacement[axis] ? result.Displacement[axis]->GetRHI() : nullptr;
+			anyAxis |= readbackSource.Axes[axis] != nullptr;
+		}
+
+		// Landed copies were published at the end of the previous frame, see OnEndFrame_RenderThread
+		mReadback.GetBackend().CommandList = &rhiCmdList;
+		if (anyAxis)
+		{
+			mReadback.Submit(readbackSource, request.Time);
+		}
+		mReadback.GetBackend().CommandList = nullptr;
+	}
+
+	// The components are only needed by this pass, a request started from the completion can have them
+	fourierComponents = FFourierComponents();
+	request.Complete(result);
 }
 
 
-void OceanTextureManager::ComputeFourierComponents(float time, FOnFourierComponentsReady onComplete)
+void OceanTextureManager::ComputeDisplacementBatch(const TArray<double>& times, FOnDisplacementBatchReady onComplete)
 {
+	if (times.IsEmpty())
+		return (void) onComplete.ExecuteIfBound(nullptr);
+
+	if (times.Num() > GetMaxDisplacementBatchSize())
+	{
+		UE_LOG(LogOcean, Error, TEXT("ComputeDisplacementBatch: %d times need %d array slices, the RHI supports %d. Split the batch."),
+			times.Num(), 3 * times.Num(), GMaxTextureArrayLayers);
+		return (void) onComplete.ExecuteIfBound(nullptr);
+	}
+
 	FOnInitialSpectraTexturesReady onInitialSpectraDrawn;
 
-	onInitialSpectraDrawn.BindLambda([this, onComplete, time](TRefCountPtr<IPooledRenderTarget> positiveSpectrum, TRefCountPtr<IPooledRenderTarget> negativeSpectrum) 
-	{
-		ENQUEUE_RENDER_COMMAND(HeightComputeCmd)([this, positiveSpectrum, negativeSpectrum, onComplete, time](FRHICommandListImmediate& rhiCmdList) mutable
-        {
-            FRDGBuilder rdgBuilder(rhiCmdList);
-            	
-            FFourierComponentsComputeShader::FParameters params;
-            params.N = mSpectrumParameters.N;
-            params.L = mSpectrumParameters.L;
-
-			static float t = 0.03f;
-			t += 0.008f;
-            params.t = time;
-    
-            // Create height texture on GPU
-            FRDGTextureDesc textureDesc = FRDGTextureDesc::Create2D(
-            	FIntPoint(mSpectrumParameters.N, mSpectrumParameters.N),
-            	PF_A32B32G32R32F,
-            	FClearValueBinding(),
-            	TexCreate_UAV
-            );
-            
-            FRDGTextureRef fourierComponentsOut_Y = rdgBuilder.CreateTexture(textureDesc, TEXT("FourierComponents_Y_Out"));
-            FRDGTextureUAVRef fourierComponentsOut_Y_UAV = rdgBuilder.CreateUAV({ fourierComponentsOut_Y });
-            params.FourierComponentsY = fourierComponentsOut_Y_UAV;
-            
-            FRDGTextureRef fourierComponentsOut_X = rdgBuilder.CreateTexture(textureDesc, TEXT("FourierComponents_X_Out"));
-            FRDGTextureUAVRef fourierComponentsOut_X_UAV = rdgBuilder.CreateUAV({ fourierComponentsOut_X });
-            params.FourierComponentsX = fourierComponentsOut_X_UAV;
-            
-            FRDGTextureRef fourierComponentsOut_Z = rdgBuilder.CreateTexture(textureDesc, TEXT("FourierComponents_Z_Out"));
-            FRDGTextureUAVRef fourierComponentsOut_Z_UAV = rdgBuilder.CreateUAV({ fourierComponentsOut_Z });
-            params.FourierComponentsZ = fourierComponentsOut_Z_UAV;
-    
-            FRDGTextureRef positiveSpectrumRef = rdgBuilder.RegisterExternalTexture(positiveSpectrum);
-            params.PositiveInitialSpectrum = rdgBuilder.CreateUAV({ positiveSpectrumRef });
-            
-            FRDGTextureRef negativeSpectrumRef = rdgBuilder.RegisterExternalTexture(negativeSpectrum);
-            params.NegativeInitialSpectrum = rdgBuilder.CreateUAV({ negativeSpectrumRef });
-    
-            // Add compute execution step
-            TShaderMapRef<FFourierComponentsComputeShader> fourierComponentsCompute(GetGlobalShaderMap(GMaxRHIFeatureLevel));
-            	
-            rdgBuilder.AddPass(
-            	RDG_EVENT_NAME("FourierComponentsComputePass"),
-            	&params,
-            	ERDGPassFlags::Compute,
-            	[&](FRHICommandListImmediate& passRhiCmdList)
-            {	
-            	FComputeShaderUtils::Dispatch(passRhiCmdList, fourierComponentsCompute, params,
-            	FIntVector(
-            		FMath::DivideAndRoundUp(mSpectrumParameters.N, NUM_THREADS_PER_GROUP_DIMENSION),
-            		FMath::DivideAndRoundUp(mSpectrumParameters.N, NUM_THREADS_PER_GROUP_DIMENSION),
-            		1)
-            	);
-            });
-
-			FFourierComponents output;
-            rdgBuilder.QueueTextureExtraction(fourierComponentsOut_X, &output.Components[0]);
-            rdgBuilder.QueueTextureExtraction(fourierComponentsOut_Y, &output.Components[1]);
-            rdgBuilder.QueueTextureExtraction(fourierComponentsOut_Z, &output.Components[2]);
-			
-            rdgBuilder.Execute();
-			onComplete.ExecuteIfBound(output);
-        });
+	onInitialSpectraDrawn.BindLambda([this, times, onComplete](TRefCountPtr<IPooledRenderTarget> positiveSpectrum, TRefCountPtr<IPooledRenderTarget> negativeSpectrum)
+	{
+		FOnButterflyTextureReady onButterflyTextureReady;
+
+		onButterflyTextureReady.BindLambda([this, times, onComplete, positiveSpectrum, negativeSpectrum](TRefCountPtr<IPooledRenderTarget> butterflyTexture)
+		{
+			ENQUEUE_RENDER_COMMAND(DisplacementBatchComputeCmd)([this, times, onComplete, positiveSpectrum, negativeSpectrum, butterflyTexture](FRHICommandListImmediate& rhiCmdList) mutable
+			{
+				FRDGBuilder rdgBuilder(rhiCmdList);
+
+				const int N = mN;
+				const int timeCount = times.Num();
+				const int sliceCount = 3 * timeCount;
+
+				// Only the real and imaginary parts are needed, so the per-slice intermediates are two channel
+				FRDGTextureDesc componentsDesc = FRDGTextureDesc::Create2DArray(
+					FIntPoint(N, N),
+					PF_G32R32F,
+					FClearValueBinding(),
+					TexCreate_UAV,
+					sliceCount
+				);
+				FRDGTextureDesc displacementDesc = FRDGTextureDesc::Create2DArray(
+					FIntPoint(N, N),
+					PF_R32_FLOAT,
+					FClearValueBinding(),
+					TexCreate_UAV,
+					sliceCount
+				);
+
+				// Upload the times split the same way as the phasor reseed so large t stays exact
+				mRenderArena.Reset();
+				TArrayView<float> splitTimes = mRenderArena.AllocateArray<float>(2 * timeCount);
+				for (int i = 0; i < timeCount; i++)
+				{
+					SplitTime(times[i], splitTimes[2 * i], splitTimes[2 * i + 1]);
+				}
+
+				FRDGBufferDesc timesBufferDesc = FRDGBufferDesc::CreateBufferDesc(sizeof(float), splitTimes.Num());
+				FRDGBufferRef timesBufferRef = rdgBuilder.CreateBuffer(timesBufferDesc, TEXT("DisplacementBatch_Times_Buffer"));
+				rdgBuilder.QueueBufferUpload(timesBufferRef, splitTimes.GetData(), splitTimes.Num() * sizeof(float));
+
+				FRDGTextureRef pingPong0Texture = rdgBuilder.CreateTexture(componentsDesc, TEXT("DisplacementBatch_PingPong0"));
+				FRDGTextureRef pingPong1Texture = rdgBuilder.CreateTexture(componentsDesc, TEXT("DisplacementBatch_PingPong1"));
+				FRDGTextureUAVRef pingpong0UAV = rdgBuilder.CreateUAV({ pingPong0Texture });
+				FRDGTextureUAVRef pingpong1UAV = rdgBuilder.CreateUAV({ pingPong1Texture });
+
+				// Fourier components for every time at once
+				FBatchedFourierComponentsComputeShader::FParameters* componentsParams = rdgBuilder.AllocParameters<FBatchedFourierComponentsComputeShader::FParameters>();
+				componentsParams->FourierComponents = pingpong0UAV;
+				componentsParams->PositiveInitialSpectrum = rdgBuilder.CreateUAV({ rdgBuilder.RegisterExternalTexture(positiveSpectrum) });
+				componentsParams->NegativeInitialSpectrum = rdgBuilder.CreateUAV({ rdgBuilder.RegisterExternalTexture(negativeSpectrum) });
+				componentsParams->Dispersion = rdgBuilder.CreateUAV({ RegisterDispersionTexture(rdgBuilder, N) });
+				componentsParams->Times = rdgBuilder.CreateUAV({ timesBufferRef, PF_R32_FLOAT });
+
+				TShaderMapRef<FBatchedFourierComponentsComputeShader> componentsCompute(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+				rdgBuilder.AddPass(
+					RDG_EVENT_NAME("BatchedFourierComponentsComputePass"),
+					componentsParams,
+					ERDGPassFlags::Compute,
+					[componentsParams, componentsCompute, N, timeCount](FRHICommandListImmediate& passRhiCmdList)
+				{
+					FComputeShaderUtils::Dispatch(passRhiCmdList, componentsCompute, *componentsParams,
+					FIntVector(
+						FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
+						FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
+						timeCount)
+					);
+				});
+
+				// One dispatch per stage transforms every slice
+				TShaderMapRef<FBatchedFFTComputeShader> fftCompute(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+				FRDGTextureUAVRef butterflyTextureUAV = rdgBuilder.CreateUAV({ rdgBuilder.RegisterExternalTexture(butterflyTexture) });
+
+				const int numStages = log2(N);
+				int pingpong = 0;
+
+				for (int direction = 0; direction < 2; direction++)
+				{
+					for (int i = 0; i < numStages; i++)
+					{
+						FBatchedFFTComputeShader::FParameters* params = rdgBuilder.AllocParameters<FBatchedFFTComputeShader::FParameters>();
+						params->direction = direction;
+						params->pingpong0 = pingpong0UAV;
+						params->pingpong1 = pingpong1UAV;
+						params->stage = i;
+						params->pingpong = pingpong % 2;
+						params->butterflyTexture = butterflyTextureUAV;
+						pingpong++;
+
+						rdgBuilder.AddPass(
+							RDG_EVENT_NAME("BatchedFFTComputePass"),
+							params,
+							ERDGPassFlags::Compute,
+							[fftCompute, params, N, sliceCount](FRHICommandListImmediate& passRhiCmdList)
+						{
+							FComputeShaderUtils::Dispatch(passRhiCmdList, fftCompute, *params,
+							FIntVector(
+								FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
+								FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
+								sliceCount)
+							);
+						});
+					}
+				}
+
+				FRDGTextureRef displacementTexture = rdgBuilder.CreateTexture(displacementDesc, TEXT("DisplacementBatch_Out"));
+				
+				FBatchedInversionComputeShader::FParameters* inversionParams = rdgBuilder.AllocParameters<FBatchedInversionComputeShader::FParameters>();
+				inversionParams->pingpong0 = pingpong0UAV;
+				inversionParams->pingpong1 = pingpong1UAV;
+				inversionParams->N = N;
+				inversionParams->pingpong = pingpong % 2;
+				inversionParams->displacement = rdgBuilder.CreateUAV({ displacementTexture });
+
+				TShaderMapRef<FBatchedInversionComputeShader> inversionCompute(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+				rdgBuilder.AddPass(
+					RDG_EVENT_NAME("BatchedInversionComputePass"),
+					inversionParams,
+					ERDGPassFlags::Compute,
+					[inversionParams, inversionCompute, N, sliceCount](FRHICommandListImmediate& passRhiCmdList)
+				{
+					FComputeShaderUtils::Dispatch(passRhiCmdList, inversionCompute, *inversionParams,
+					FIntVector(
+						FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
+						FMath::DivideAndRoundUp(N, NUM_THREADS_PER_GROUP_DIMENSION),
+						sliceCount)
+					);
+				});
+
+				TRefCountPtr<IPooledRenderTarget> output;
+				rdgBuilder.QueueTextureExtraction(displacementTexture, &output);
+				rdgBuilder.Execute();
+
+				onComplete.ExecuteIfBound(output);
+			});
+		});
+
+		ComputeButterfly(onButterflyTextureReady);
 	});
 
 	ComputeInitialSpectra(onInitialSpectraDrawn);
 }
 
 
-void OceanTextureManager::ComputeDisplacement(float time, FOnDisplacementFieldReady onComplete, UTextureRenderTarget2D* displacementOutXTarget, UTextureRenderTarget2D* displacementOutYTarget, UTextureRenderTarget2D* displacementOutZTarget, UTextureRenderTarget2D* foamOutTarget)
+int OceanTextureManager::GetMaxDisplacementBatchSize()
+{
+	return GMaxTextureArrayLayers / 3;
+}
+
+
+FOceanRHIResourceBackend::FResource FOceanRHIResourceBackend::Allocate(const FOceanResourceKey& key)
+{
+	static const TCHAR* names[] { TEXT("Ocean_FourierComponents"), TEXT("Ocean_FFT_PingPong1"), TEXT("Ocean_Displacement"), TEXT("Ocean_Normals"), TEXT("Ocean_Foam") };
+
+	// GRenderTargetPool keeps a reference to each of its elements, IsUnused would never be true for them
+	const FRHITextureCreateDesc desc = FRHITextureCreateDesc::Create2D(names[(int)key.Resource], key.N, key.N, key.Format)
+		.SetFlags(ETextureCreateFlags::UAV | ETextureCreateFlags::ShaderResource)
+		.SetInitialState(ERHIAccess::UAVCompute);
+
+	return CreateRenderTarget(RHICreateTexture(desc), names[(int)key.Resource]);
+}
+
+
+bool FOceanRHIResourceBackend::CanWriteDirectly(const FTarget& target, const FOceanResourceKey& key) const
+{
+	const FTextureRenderTargetResource* resource = target->GetRenderTargetResource();
+	const FRHITexture* texture = resource ? resource->GetTextureRHI() : nullptr;
+
+	return texture
+		&& EnumHasAnyFlags(texture->GetDesc().Flags, TexCreate_UAV)
+		&& texture->GetSizeXY() == FIntPoint(key.N, key.N)
+		&& texture->GetFormat() == key.Format;
+}
+
+
+bool FOceanRHIResourceBackend::Copy(const FResource& source, const FTarget& target)
 {
-	FOnFourierComponentsReady onFourierComponentsReady;
+	FRHITexture* targetTexture = target->GetRenderTargetResource()->GetTextureRHI();
+
+	// Right after a resolution switch the targets may not have been resized yet, skip those frames
+	if (targetTexture->GetSizeXY() != source->GetDesc().Extent)
+		return false;
+
+	CommandList->CopyTexture(source->GetRHI(), targetTexture, FRHICopyTextureInfo());
+	return true;
+}
 
-	onFourierComponentsReady.BindLambda([this, onComplete, displacementOutXTarget, displacementOutYTarget, displacementOutZTarget, foamOutTarget](FFourierComponents fourierComponents)
+
+void FOceanRHIReadbackBackend::Copy(FStaging& staging, const FSource& source)
+{
+	for (int axis = 0; axis < 3; axis++)
 	{
-		FOnButterflyTextureReady onButterflyTextureReady;
+		staging.bCopied[axis] = source.Axes[axis] != nullptr;
+		if (!source.Axes[axis])
+			continue;
+
+		if (!staging.Readbacks[axis])
+		{
+			staging.Readbacks[axis] = MakeUnique<FRHIGPUTextureReadback>(TEXT("OceanDisplacementReadback"));
+		}
+
+		staging.Readbacks[axis]->EnqueueCopy(*CommandList, source.Axes[axis]);
+		staging.N = source.Axes[axis]->GetSizeX();
+	}
+}
+
+
+bool FOceanRHIReadbackBackend::IsReady(FStaging& staging) const
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (staging.bCopied[axis] && !staging.Readbacks[axis]->IsReady())
+			return false;
+	}
+	return true;
+}
+
+
+void FOceanRHIReadbackBackend::Read(FStaging& staging, FOceanReadbackFrame& frame)
+{
+	const int N = staging.N;
+	frame.N = N;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (!staging.bCopied[axis])
+		{
+			frame.Axes[axis].Reset();
+			continue;
+		}
+
+		int32 rowPitchInPixels = 0;
+		const FVector4f* texels = static_cast<const FVector4f*>(staging.Readbacks[axis]->Lock(rowPitchInPixels));
+
+		// The inversion writes the displacement to every colour channel
+		frame.Axes[axis].SetNumUninitialized(N * N);
+		for (int y = 0; y < N; y++)
+		{
+			for (int x = 0; x < N; x++)
+			{
+				frame.Axes[axis][y * N + x] = texels[y * rowPitchInPixels + x].X;
+			}
+		}
+
+		staging.Readbacks[axis]->Unlock();
+	}
+}
+
+
+OceanTextureManager* OceanTextureManager::mSingleton;
+
 
-		onButterflyTextureReady.BindLambda([this, fourierComponents, onComplete, displacementOutXTarget, displacementOutYTarget, displacementOutZTarget, foamOutTarget](TRefCountPtr<IPooledRenderTarget> butterflyTexture)
+static FAutoConsoleCommand GOceanMeasureDisplacementBatchCommand(
+	TEXT("Ocean.DisplacementBatch.Measure"),
+	TEXT("Times [K] (default 8) separate ComputeDisplacement calls against one ComputeDisplacementBatch of K times on the GPU and logs the time per timestep of both. Flushes the render thread, diagnostics only."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args)
+	{
+		OceanTextureManager* manager = OceanTextureManager::Get();
+		const int K = FMath::Clamp(args.Num() > 0 ? FCString::Atoi(*args[0]) : 8, 1, OceanTextureManager::GetMaxDisplacementBatchSize());
+
+		TArray<double> times;
+		for (int i = 0; i < K; i++)
+		{
+			times.Add(i / 60.0);
+		}
+
+		// Begin and end of the separate calls, then of the batch
+		struct FQueries
 		{
-			ENQUEUE_RENDER_COMMAND(HeightComputeCmd)([this, fourierComponents, onComplete, butterflyTexture, displacementOutXTarget, displacementOutYTarget, displacementOutZTarget, foamOutTarget](FRHICommandListImmediate& rhiCmdList) mutable
-            {
-                FRDGBuilder rdgBuilder(rhiCmdList);
-				TShaderMapRef<FFFTComputeShader> fftCompute(GetGlobalShaderMap(GMaxRHIFeatureLevel));
-        
-                // Create height texture on GPU
-                FRDGTextureDesc textureDesc = FRDGTextureDesc::Create2D(
-                    FIntPoint(mSpectrumParameters.N, mSpectrumParameters.N),
-                    PF_A32B32G32R32F,
-                    FClearValueBinding(),
-                    TexCreate_UAV
-                );
-        		
-                FRDGTextureRef butterflyRef = rdgBuilder.RegisterExternalTexture(butterflyTexture);
-                FRDGTextureUAVRef butterflyTextureUAV = rdgBuilder.CreateUAV({butterflyRef});
-
-				TRefCountPtr<IPooledRenderTarget> displacementTexturesInternal[] { nullptr, nullptr, nullptr };
-				TRefCountPtr<IPooledRenderTarget> foamTextureInternal;
-				UTextureRenderTarget2D* displacementTargets[] { displacementOutXTarget, displacementOutYTarget, displacementOutZTarget };
-				FRDGTextureRef displacementTextures[] { 
-					rdgBuilder.CreateTexture(textureDesc, TEXT("Displacement_OutX")),
-					rdgBuilder.CreateTexture(textureDesc, TEXT("Displacement_OutY")),
-					rdgBuilder.CreateTexture(textureDesc, TEXT("Displacement_OutZ"))
-				};
-
-				FRDGTextureUAVRef displacementTexturesUAV[] { nullptr, nullptr, nullptr };
-
-				for (int axis = 0; axis < 3; axis++)
+			FRenderQueryPoolRHIRef Pool;
+			FRHIPooledRenderQuery Timestamps[4];
+		};
+		TSharedRef<FQueries, ESPMode::ThreadSafe> queries = MakeShared<FQueries, ESPMode::ThreadSafe>();
+
+		auto timestamp = [queries](int index)
+		{
+			ENQUEUE_RENDER_COMMAND(MeasureDisplacementBatchTimestampCmd)([queries, index](FRHICommandListImmediate& rhiCmdList)
+			{
+				if (!queries->Pool.IsValid())
 				{
-	                FRDGTextureRef fourierComponentsRef = rdgBuilder.RegisterExternalTexture(fourierComponents.Components[axis]);
-                    FRDGTextureUAVRef pingpong0UAV = rdgBuilder.CreateUAV({fourierComponentsRef});
-                    
-                    FRDGTextureRef pingPong1Texture = rdgBuilder.CreateTexture(textureDesc, TEXT("FFT_PingPong1_Out"));
-                    FRDGTextureUAVRef pingPong1Texture_UAV = rdgBuilder.CreateUAV({ pingPong1Texture });
-                    FRDGTextureUAVRef pingpong1UAV = pingPong1Texture_UAV;
-    
-                    enum class FFTDirection { Horizontal, Vertical };
-                    const int numStages = log2(mSpectrumParameters.N);
-                    int pingpong = 0;
-    
-                    for (auto direction: { FFTDirection::Horizontal, FFTDirection::Vertical })
-                    {
-                        for (int i = 0; i < numStages; i++)
-                        {
-                            FFFTComputeShader::FParameters* params = rdgBuilder.AllocParameters<FFFTComputeShader::FParameters>();
-                            params->direction = (int)direction;
-                            params->pingpong0 = pingpong0UAV;
-                            params->pingpong1 = pingpong1UAV;
-                            params->stage = i;
-                            params->pingpong = pingpong % 2;
-                            params->butterflyTexture = butterflyTextureUAV;
-                            pingpong++;
-                            
-                            // Add compute execution step
-                            rdgBuilder.AddPass(
-                                RDG_EVENT_NAME("FFTComputePass"),
-                                params,
-                                ERDGPassFlags::Compute,
-                                [fftCompute, params, this](FRHICommandListImmediate& passRhiCmdList)
-                            {	
-                                FComputeShaderUtils::Dispatch(passRhiCmdList, fftCompute, *params,
-                                FIntVector(
-                                    FMath::DivideAndRoundUp(mSpectrumParameters.N, NUM_THREADS_PER_GROUP_DIMENSION),
-                                    FMath::DivideAndRoundUp(mSpectrumParameters.N, NUM_THREADS_PER_GROUP_DIMENSION),
-                                    1)
-                                );
-                            });
-                        }
-                    }
-					
-                    FInversionComputeShader::FParameters* inversionParams = rdgBuilder.AllocParameters<FInversionComputeShader::FParameters>();
-                    inversionParams->pingpong0 = pingpong0UAV;
-                    inversionParams->pingpong1 = pingpong1UAV;
-                    inversionParams->N = mSpectrumParameters.N;
-                    inversionParams->pingpong = pingpong % 2;
-                    inversionParams->displacement = displacementTexturesUAV[axis] = rdgBuilder.CreateUAV({ displacementTextures[axis] });
-                    
-                    TShaderMapRef<FInversionComputeShader> inversionCompute (GetGlobalShaderMap(GMaxRHIFeatureLevel));
-                    rdgBuilder.AddPass(
-                    	RDG_EVENT_NAME("InversionComputePass"),
-                    	inversionParams,
-                    	ERDGPassFlags::Compute,
-                    	[inversionParams, inversionCompute, this](FRHICommandListImmediate& passRhiCmdList)
-                    {	
-                    	FComputeShaderUtils::Dispatch(passRhiCmdList, inversionCompute, *inversionParams,
-                    	FIntVector(
-                    		FMath::DivideAndRoundUp(mSpectrumParameters.N, NUM_THREADS_PER_GROUP_DIMENSION),
-                    		FMath::DivideAndRoundUp(mSpectrumParameters.N, NUM_THREADS_PER_GROUP_DIMENSION),
-                    		1)
-                    	);
-                    });
+					queries->Pool = RHICreateRenderQueryPool(RQT_AbsoluteTime);
 				}
+				queries->Timestamps[index] = queries->Pool->AllocateQuery();
+				rhiCmdList.EndRenderQuery(queries->Timestamps[index].GetQuery());
+			});
+		};
 
-				FRDGTextureRef normals = rdgBuilder.CreateTexture(textureDesc, TEXT("Normals_Out"));
-				FNormalsComputeShader::FParameters* normalsParams = rdgBuilder.AllocParameters<FNormalsComputeShader::FParameters>();
-				normalsParams->displacementX = displacementTexturesUAV[0];
-				normalsParams->displacementY = displacementTexturesUAV[2];
-				normalsParams->normals = rdgBuilder.CreateUAV({ normals });
-				
-				TShaderMapRef<FNormalsComputeShader> normalsCompute (GetGlobalShaderMap(GMaxRHIFeatureLevel));
-                rdgBuilder.AddPass(
-                    RDG_EVENT_NAME("NormalsComputePass"),
-                    normalsParams,
-                    ERDGPassFlags::Compute,
-                    [normalsParams, normalsCompute, this](FRHICommandListImmediate& passRhiCmdList)
-                {	
-                    FComputeShaderUtils::Dispatch(passRhiCmdList, normalsCompute, *normalsParams,
-                    FIntVector(
-                    	FMath::DivideAndRoundUp(mSpectrumParameters.N, NUM_THREADS_PER_GROUP_DIMENSION),
-                    	FMath::DivideAndRoundUp(mSpectrumParameters.N, NUM_THREADS_PER_GROUP_DIMENSION),
-                    	1)
-                    );
-                });
-				
-				FRDGTextureRef foamTexture = rdgBuilder.CreateTexture(textureDesc, TEXT("Foam_Out"));
-				FFoamComputeShader::FParameters* foamParams = rdgBuilder.AllocParameters<FFoamComputeShader::FParameters>();
-				foamParams->normals = normalsParams->normals;
-				foamParams->foam = rdgBuilder.CreateUAV({ foamTexture });
-				this->mLastFoamTexture = foamTextureInternal;
-				
-				TShaderMapRef<FFoamComputeShader> foamCompute (GetGlobalShaderMap(GMaxRHIFeatureLevel));
-                rdgBuilder.AddPass(
-                    RDG_EVENT_NAME("FoamComputePass"),
-                    foamParams,
-                    ERDGPassFlags::Compute,
-                    [foamParams, foamCompute, this](FRHICommandListImmediate& passRhiCmdList)
-                {	
-                    FComputeShaderUtils::Dispatch(passRhiCmdList, foamCompute, *foamParams,
-                    FIntVector(
-                    	FMath::DivideAndRoundUp(mSpectrumParameters.N, NUM_THREADS_PER_GROUP_DIMENSION),
-                    	FMath::DivideAndRoundUp(mSpectrumParameters.N, NUM_THREADS_PER_GROUP_DIMENSION),
-                    	1)
-                    );
-                });
-				
-                rdgBuilder.QueueTextureExtraction(displacementTextures[0], &displacementTexturesInternal[0]);
-                rdgBuilder.QueueTextureExtraction(displacementTextures[1], &displacementTexturesInternal[1]);
-				rdgBuilder.QueueTextureExtraction(displacementTextures[2], &displacementTexturesInternal[2]);
-				rdgBuilder.QueueTextureExtraction(foamTexture, &foamTextureInternal);
-                rdgBuilder.Execute();
-				
-				rhiCmdList.CopyTexture(displacementTexturesInternal[0]->GetRHI(), displacementTargets[0]->GetRenderTargetResource()->GetTextureRHI(), FRHICopyTextureInfo());
-				rhiCmdList.CopyTexture(displacementTexturesInternal[1]->GetRHI(), displacementTargets[1]->GetRenderTargetResource()->GetTextureRHI(), FRHICopyTextureInfo());
-				rhiCmdList.CopyTexture(displacementTexturesInternal[2]->GetRHI(), displacementTargets[2]->GetRenderTargetResource()->GetTextureRHI(), FRHICopyTextureInfo());
-				rhiCmdList.CopyTexture(foamTextureInternal->GetRHI(), foamOutTarget->GetRenderTargetResource()->GetTextureRHI(), FRHICopyTextureInfo());
-            });	
+		// Warm caches (spectra, butterflies, dispersion, shaders) outside the timed region
+		manager->ComputeDisplacementBatch(times, OceanTextureManager::FOnDisplacementBatchReady());
+		manager->ComputeDisplacement(0.0, OceanTextureManager::FOnDisplacementFieldReady(), nullptr, nullptr, nullptr, nullptr, EOceanOutputs::Height | EOceanOutputs::Choppiness);
+		FlushRenderingCommands();
+
+		// Commands enqueued from the render thread run inline, so each flush covers the whole delegate chain
+		timestamp(0);
+		for (int i = 0; i < K; i++)
+		{
+			manager->ComputeDisplacement(times[i], OceanTextureManager::FOnDisplacementFieldReady(), nullptr, nullptr, nullptr, nullptr, EOceanOutputs::Height | EOceanOutputs::Choppiness);
+		}
+		FlushRenderingCommands();
+		timestamp(1);
+
+		timestamp(2);
+		manager->ComputeDisplacementBatch(times, OceanTextureManager::FOnDisplacementBatchReady());
+		FlushRenderingCommands();
+		timestamp(3);
+
+		ENQUEUE_RENDER_COMMAND(MeasureDisplacementBatchReportCmd)([queries, K](FRHICommandListImmediate& rhiCmdList)
+		{
+			uint64 microseconds[4];
+			for (int i = 0; i < 4; i++)
+			{
+				RHIGetRenderQueryResult(queries->Timestamps[i].GetQuery(), microseconds[i], true);
+			}
+
+			const double separateMs = (microseconds[1] - microseconds[0]) / 1000.0;
+			const double batchMs = (microseconds[3] - microseconds[2]) / 1000.0;
+			UE_LOG(LogOcean, Display, TEXT("Displacement of %d times: separate %.3f ms (%.3f ms per time), batch %.3f ms (%.3f ms per time), %.2fx per-timestep throughput"),
+				K, separateMs, separateMs / K, batchMs, batchMs / K, batchMs > 0.0 ? separateMs / batchMs : 0.0);
 		});
-		
-		ComputeButterfly(onButterflyTextureReady);
+		FlushRenderingCommands();
+	}));
+
+
+static FAutoConsoleCommand GOceanCheckDisplacementAllocationsCommand(
+	TEXT("Ocean.Displacement.CheckAllocations"),
+	TEXT("Runs [Frames] (default 64) ComputeDisplacement calls with alternating outputs after a warm-up and fails if the render arena, the resource pool or the request pool allocated after the warm-up. Flushes the render thread, diagnostics only."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args)
+	{
+		OceanTextureManager* manager = OceanTextureManager::Get();
+		const int frames = args.Num() > 0 ? FMath::Max(FCString::Atoi(*args[0]), 1) : 64;
+
+		struct FSnapshot
+		{
+			int64 ArenaHeapAllocations = 0;
+			int64 PoolAllocations = 0;
+			int Requests = 0;
+		};
+
+		auto snapshot = [manager](FSnapshot& result)
+		{
+			FlushRenderingCommands();
+			result.Requests = manager->GetNumDisplacementRequests();
+
+			ENQUEUE_RENDER_COMMAND(CheckDisplacementAllocationsCmd)([manager, &result](FRHICommandListImmediate& rhiCmdList)
+			{
+				result.ArenaHeapAllocations = manager->GetRenderArenaStats().HeapAllocations;
+				result.PoolAllocations = manager->GetResourcePoolStats().Allocations;
+			});
+			FlushRenderingCommands();
+		};
+
+		const EOceanOutputs outputs[] { EOceanOutputs::All, EOceanOutputs::Height, EOceanOutputs::Height | EOceanOutputs::Choppiness };
+		const int numOutputs = UE_ARRAY_COUNT(outputs);
+
+		// One round of every output mix warms the pool, the spectra and the butterflies
+		for (int i = 0; i < numOutputs; i++)
+		{
+			manager->ComputeDisplacement(i / 60.0, OceanTextureManager::FOnDisplacementFieldReady(), nullptr, nullptr, nullptr, nullptr, outputs[i]);
+		}
+
+		FSnapshot warm;
+		snapshot(warm);
+
+		// The render thread is flushed every frame so the number of requests in flight can't grow with the frame count
+		for (int frame = 0; frame < frames; frame++)
+		{
+			manager->ComputeDisplacement((frame + numOutputs) / 60.0, OceanTextureManager::FOnDisplacementFieldReady(), nullptr, nullptr, nullptr, nullptr, outputs[frame % numOutputs]);
+			FlushRenderingCommands();
+		}
+
+		FSnapshot end;
+		snapshot(end);
+
+		UE_LOG(LogOcean, Display, TEXT("Displacement over %d frames after warm-up: %lld render arena blocks, %lld pooled resources, %d requests allocated"),
+			frames, end.ArenaHeapAllocations - warm.ArenaHeapAllocations, end.PoolAllocations - warm.PoolAllocations, end.Requests - warm.Requests);
+		ensureMsgf(end.ArenaHeapAllocations == warm.ArenaHeapAllocations && end.PoolAllocations == warm.PoolAllocations && end.Requests == warm.Requests,
+			TEXT("Ocean displacement allocated after warm-up"));
+	}));
+
+
+// Coroutine behind Ocean.Displacement.CheckAsync. The render thread is held until every request is queued, so which
+// of them are dropped doesn't depend on how far it got in the meantime.
+static TOceanFuture<bool> CheckDisplacementChannels(OceanTextureManager* manager)
+{
+	using FDisplacementResult = OceanTextureManager::FDisplacementResult;
+
+	if (!GIsThreadedRendering)
+	{
+		UE_LOG(LogOcean, Warning, TEXT("Ocean.Displacement.CheckAsync needs a rendering thread"));
+		co_return false;
+	}
+
+	FEvent* renderGate = FPlatformProcess::GetSynchEventFromPool(true);
+	ENQUEUE_RENDER_COMMAND(CheckDisplacementGateCmd)([renderGate](FRHICommandListImmediate& rhiCmdList)
+	{
+		renderGate->Wait();
+		FPlatformProcess::ReturnSynchEventToPool(renderGate);
 	});
 
-	ComputeFourierComponents(time, onFourierComponentsReady);
+	// Channel 1's first request is superseded by its second, channel 2's is cancelled
+	TArray<TOceanFuture<FDisplacementResult>> futures;
+	futures.Add(manager->Displacement(1.0, {}, EOceanOutputs::Height, 1));
+	futures.Add(manager->Displacement(2.0, {}, EOceanOutputs::Height, 2));
+	futures.Add(manager->Displacement(3.0, {}, EOceanOutputs::Height, 1));
+	futures[1].Cancel();
+
+	// Order in which the render thread resolved them, it should be the order they were requested in
+	TSharedRef<TArray<double>, ESPMode::ThreadSafe> resolved = MakeShared<TArray<double>, ESPMode::ThreadSafe>();
+	for (const TOceanFuture<FDisplacementResult>& future : futures)
+	{
+		future.Then([resolved](const FDisplacementResult& result) { resolved->Add(result.Time); });
+	}
+
+	renderGate->Trigger();
+
+	const TArray<FDisplacementResult> results = co_await WhenAll(futures);
+
+	const bool cancelledOnly = results.Num() == 3
+		&& results[0].bCancelled && !results[0].Displacement[1].IsValid()
+		&& results[1].bCancelled && !results[1].Displacement[1].IsValid()
+		&& !results[2].bCancelled && results[2].Displacement[1].IsValid();
+	const bool inOrder = results.Num() == 3 && results[0].Time == 1.0 && results[1].Time == 2.0 && results[2].Time == 3.0
+		&& *resolved == TArray<double> { 1.0, 2.0, 3.0 };
+
+	UE_LOG(LogOcean, Display, TEXT("Displacement channels: superseded %d, cancelled %d, kept %d, resolved in order %d"),
+		results.Num() > 0 && results[0].bCancelled, results.Num() > 1 && results[1].bCancelled, results.Num() > 2 && !results[2].bCancelled, inOrder);
+	ensureMsgf(cancelledOnly, TEXT("Ocean displacement dropped the wrong requests"));
+	ensureMsgf(inOrder, TEXT("Ocean displacement requests resolved out of order"));
+
+	co_return cancelledOnly && inOrder;
 }
 
 
-OceanTextureManager* OceanTextureManager::mSingleton;
-TRefCountPtr<IPooledRenderTarget> OceanTextureManager::mLastFoamTexture;
+static FAutoConsoleCommand GOceanCheckDisplacementAsyncCommand(
+	TEXT("Ocean.Displacement.CheckAsync"),
+	TEXT("Awaits height requests on two channels from a coroutine, one superseded and one cancelled before they reach the GPU, and fails if the wrong ones resolve as cancelled or they resolve out of order."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		CheckDisplacementChannels(OceanTextureManager::Get()).Then([](const bool& passed)
+		{
+			UE_LOG(LogOcean, Display, TEXT("Ocean.Displacement.CheckAsync %s"), passed ? TEXT("passed") : TEXT("failed"));
+		});
+	}));
@@ -0,0 +1,689 @@
+#include "OceanVectorMath.h"
+
+#include <atomic>
+#include <cmath>
+
+#include "CustomShaders.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+#if PLATFORM_CPU_X86_FAMILY
+	#include <immintrin.h>
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+
+// Code between BEGIN and END is compiled for the given instruction set regardless of the module's target flags.
+// MSVC accepts every intrinsic without them. Only explicit MulAdd calls may fuse: GCC would otherwise contract
+// separate multiply and add intrinsics, which changes the noise hash argument (clang does not contract across them).
+#if defined(__clang__)
+	#define OCEAN_BEGIN_TARGET(Target) _Pragma(OCEAN_STRINGIZE(clang attribute push(__attribute__((target(Target))), apply_to = function)))
+	#define OCEAN_END_TARGET() _Pragma("clang attribute pop")
+#elif defined(__GNUC__)
+	#define OCEAN_BEGIN_TARGET(Target) _Pragma("GCC push_options") _Pragma(OCEAN_STRINGIZE(GCC target(Target))) _Pragma("GCC optimize(\"fp-contract=off\")")
+	#define OCEAN_END_TARGET() _Pragma("GCC pop_options")
+#else
+	#define OCEAN_BEGIN_TARGET(Target)
+	#define OCEAN_END_TARGET()
+#endif
+#define OCEAN_STRINGIZE(Text) #Text
+
+
+namespace
+{
+	struct FKernelTable
+	{
+		void (*SinCos)(const float* x, float* sinOut, float* cosOut, int count);
+		void (*SinCosTurns)(const float* turns, float* sinOut, float* cosOut, int count);
+		void (*Log)(const float* x, float* out, int count);
+		void (*Sqrt)(const float* x, float* out, int count);
+		void (*NoiseRow)(float firstX, float y, float* out, int count);
+		void (*GaussRandom)(const float* uniform0, const float* uniform1, FOceanComplex* out, int count);
+		void (*EvolveSpectrum)(const OceanVectorMath::FSpectrumBins& bins, float timeHi, float timeLo, FOceanComplex* outX, FOceanComplex* outY, FOceanComplex* outZ, int count);
+	};
+}
+
+
+// Reference implementations, one libm call per element
+namespace OceanVectorMathScalar
+{
+	void SinCos(const float* x, float* sinOut, float* cosOut, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			sinOut[i] = FMath::Sin(x[i]);
+			cosOut[i] = FMath::Cos(x[i]);
+		}
+	}
+
+	// Quarter turns are taken off first so multiples of pi / 2 come out exact
+	void SinCosTurns(const float* turns, float* sinOut, float* cosOut, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			const float t = turns[i] - FMath::RoundHalfToEven(turns[i]);
+			const float quarter = FMath::RoundHalfToEven(4.0f * t);
+			const float radians = 2.0f * UE_PI * (t - 0.25f * quarter);
+			const float sinR = FMath::Sin(radians);
+			const float cosR = FMath::Cos(radians);
+
+			switch ((int)quarter & 3)
+			{
+			case 0: sinOut[i] = sinR; cosOut[i] = cosR; break;
+			case 1: sinOut[i] = cosR; cosOut[i] = -sinR; break;
+			case 2: sinOut[i] = -sinR; cosOut[i] = -cosR; break;
+			default: sinOut[i] = -cosR; cosOut[i] = sinR; break;
+			}
+		}
+	}
+
+	void Log(const float* x, float* out, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			out[i] = FMath::Loge(x[i]);
+		}
+	}
+
+	void Sqrt(const float* x, float* out, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			out[i] = FMath::Sqrt(x[i]);
+		}
+	}
+
+	void NoiseRow(float firstX, float y, float* out, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			const float value = FMath::Sin((firstX + i) * 12.9898f + y * 78.233f) * 43758.5453123f;
+			out[i] = value - FMath::FloorToFloat(value);
+		}
+	}
+
+	void GaussRandom(const float* uniform0, const float* uniform1, FOceanComplex* out, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			const float u = 2.0f * UE_PI * FMath::Clamp(uniform0[i], 0.001f, 1.0f);
+			const float v = FMath::Sqrt(-2.0f * FMath::Loge(FMath::Clamp(uniform1[i], 0.001f, 1.0f)));
+			out[i] = { v * FMath::Cos(u), v * FMath::Sin(u) };
+		}
+	}
+
+	void EvolveSpectrum(const OceanVectorMath::FSpectrumBins& bins, float timeHi, float timeLo, FOceanComplex* outX, FOceanComplex* outY, FOceanComplex* outZ, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			const float fHi = bins.FrequencyHi[i];
+			const float fLo = bins.FrequencyLo[i];
+			const float cycles = FMath::Frac(fHi * timeHi) + FMath::Frac(fLo * timeHi) + FMath::Frac((fHi + fLo) * timeLo);
+
+			float sinWt, cosWt;
+			SinCosTurns(&cycles, &sinWt, &cosWt, 1);
+
+			const FOceanComplex expIwt(cosWt, sinWt);
+			const FOceanComplex height = bins.Positive[i] * expIwt + bins.Negative[i].Conjugate() * expIwt.Conjugate();
+			const FVector2f unitK = bins.UnitWaveVector[i];
+
+			if (outX) outX[i] = FOceanComplex(0.0f, -unitK.X) * height;
+			if (outY) outY[i] = height;
+			if (outZ) outZ[i] = FOceanComplex(0.0f, -unitK.Y) * height;
+		}
+	}
+
+	const FKernelTable Kernels { &SinCos, &SinCosTurns, &Log, &Sqrt, &NoiseRow, &GaussRandom, &EvolveSpectrum };
+}
+
+
+#if PLATFORM_CPU_X86_FAMILY
+
+OCEAN_BEGIN_TARGET("sse4.1")
+namespace OceanVectorMathSSE4
+{
+	// The interface every instruction set implements for OceanVectorMathKernels.inl
+	struct FVec
+	{
+		using FFloat = __m128;
+		using FInt = __m128i;
+		// All ones or all zeros per lane
+		using FMask = __m128;
+		static constexpr int Width = 4;
+
+		static FORCEINLINE FFloat Load(const float* data) { return _mm_loadu_ps(data); }
+		static FORCEINLINE void Store(float* data, FFloat value) { _mm_storeu_ps(data, value); }
+
+		// Interleaved (re, im) pairs to and from one register of each
+		static FORCEINLINE void LoadComplex(const float* data, FFloat& re, FFloat& im)
+		{
+			const FFloat low = _mm_loadu_ps(data);
+			const FFloat high = _mm_loadu_ps(data + 4);
+			re = _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0));
+			im = _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1));
+		}
+		static FORCEINLINE void StoreComplex(float* data, FFloat re, FFloat im)
+		{
+			_mm_storeu_ps(data, _mm_unpacklo_ps(re, im));
+			_mm_storeu_ps(data + 4, _mm_unpackhi_ps(re, im));
+		}
+
+		static FORCEINLINE FFloat Set(float value) { return _mm_set1_ps(value); }
+		static FORCEINLINE FInt SetInt(int32 value) { return _mm_set1_epi32(value); }
+
+		static FORCEINLINE FFloat Add(FFloat a, FFloat b) { return _mm_add_ps(a, b); }
+		static FORCEINLINE FFloat Sub(FFloat a, FFloat b) { return _mm_sub_ps(a, b); }
+		static FORCEINLINE FFloat Mul(FFloat a, FFloat b) { return _mm_mul_ps(a, b); }
+		// a * b + c
+		static FORCEINLINE FFloat MulAdd(FFloat a, FFloat b, FFloat c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		static FORCEINLINE FFloat Min(FFloat a, FFloat b) { return _mm_min_ps(a, b); }
+		static FORCEINLINE FFloat Max(FFloat a, FFloat b) { return _mm_max_ps(a, b); }
+		static FORCEINLINE FFloat Sqrt(FFloat a) { return _mm_sqrt_ps(a); }
+		// To nearest, ties to even
+		static FORCEINLINE FFloat Round(FFloat a) { return _mm_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+		static FORCEINLINE FFloat Floor(FFloat a) { return _mm_floor_ps(a); }
+		static FORCEINLINE FFloat Xor(FFloat a, FFloat b) { return _mm_xor_ps(a, b); }
+
+		// a has to be integral already
+		static FORCEINLINE FInt ToInt(FFloat a) { return _mm_cvttps_epi32(a); }
+		static FORCEINLINE FFloat ToFloat(FInt a) { return _mm_cvtepi32_ps(a); }
+		static FORCEINLINE FInt AsInt(FFloat a) { return _mm_castps_si128(a); }
+		static FORCEINLINE FFloat AsFloat(FInt a) { return _mm_castsi128_ps(a); }
+
+		static FORCEINLINE FInt AddInt(FInt a, FInt b) { return _mm_add_epi32(a, b); }
+		static FORCEINLINE FInt SubInt(FInt a, FInt b) { return _mm_sub_epi32(a, b); }
+		static FORCEINLINE FInt AndInt(FInt a, FInt b) { return _mm_and_si128(a, b); }
+		static FORCEINLINE FInt OrInt(FInt a, FInt b) { return _mm_or_si128(a, b); }
+		template <int Shift> static FORCEINLINE FInt ShiftLeftInt(FInt a) { return _mm_slli_epi32(a, Shift); }
+		// Logical
+		template <int Shift> static FORCEINLINE FInt ShiftRightInt(FInt a) { return _mm_srli_epi32(a, Shift); }
+
+		static FORCEINLINE FMask Less(FFloat a, FFloat b) { return _mm_cmplt_ps(a, b); }
+		static FORCEINLINE FMask EqualInt(FInt a, FInt b) { return _mm_castsi128_ps(_mm_cmpeq_epi32(a, b)); }
+		static FORCEINLINE FFloat Select(FMask mask, FFloat ifTrue, FFloat ifFalse) { return _mm_blendv_ps(ifFalse, ifTrue, mask); }
+	};
+
+	#include "OceanVectorMathKernels.inl"
+}
+OCEAN_END_TARGET()
+
+
+OCEAN_BEGIN_TARGET("avx2,fma")
+namespace OceanVectorMathAVX2
+{
+	struct FVec
+	{
+		using FFloat = __m256;
+		using FInt = __m256i;
+		using FMask = __m256;
+		static constexpr int Width = 8;
+
+		static FORCEINLINE FFloat Load(const float* data) { return _mm256_loadu_ps(data); }
+		static FORCEINLINE void Store(float* data, FFloat value) { _mm256_storeu_ps(data, value); }
+
+		// The in-lane shuffles leave 64-bit pairs in 0 2 1 3 order, the cross-lane permute fixes that up
+		static FORCEINLINE void LoadComplex(const float* data, FFloat& re, FFloat& im)
+		{
+			const FFloat low = _mm256_loadu_ps(data);
+			const FFloat high = _mm256_loadu_ps(data + 8);
+			re = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+			im = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+		}
+		static FORCEINLINE void StoreComplex(float* data, FFloat re, FFloat im)
+		{
+			const FFloat low = _mm256_unpacklo_ps(re, im);
+			const FFloat high = _mm256_unpackhi_ps(re, im);
+			_mm256_storeu_ps(data, _mm256_permute2f128_ps(low, high, 0x20));
+			_mm256_storeu_ps(data + 8, _mm256_permute2f128_ps(low, high, 0x31));
+		}
+
+		static FORCEINLINE FFloat Set(float value) { return _mm256_set1_ps(value); }
+		static FORCEINLINE FInt SetInt(int32 value) { return _mm256_set1_epi32(value); }
+
+		static FORCEINLINE FFloat Add(FFloat a, FFloat b) { return _mm256_add_ps(a, b); }
+		static FORCEINLINE FFloat Sub(FFloat a, FFloat b) { return _mm256_sub_ps(a, b); }
+		static FORCEINLINE FFloat Mul(FFloat a, FFloat b) { return _mm256_mul_ps(a, b); }
+		static FORCEINLINE FFloat MulAdd(FFloat a, FFloat b, FFloat c) { return _mm256_fmadd_ps(a, b, c); }
+		static FORCEINLINE FFloat Min(FFloat a, FFloat b) { return _mm256_min_ps(a, b); }
+		static FORCEINLINE FFloat Max(FFloat a, FFloat b) { return _mm256_max_ps(a, b); }
+		static FORCEINLINE FFloat Sqrt(FFloat a) { return _mm256_sqrt_ps(a); }
+		static FORCEINLINE FFloat Round(FFloat a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+		static FORCEINLINE FFloat Floor(FFloat a) { return _mm256_floor_ps(a); }
+		static FORCEINLINE FFloat Xor(FFloat a, FFloat b) { return _mm256_xor_ps(a, b); }
+
+		static FORCEINLINE FInt ToInt(FFloat a) { return _mm256_cvttps_epi32(a); }
+		static FORCEINLINE FFloat ToFloat(FInt a) { return _mm256_cvtepi32_ps(a); }
+		static FORCEINLINE FInt AsInt(FFloat a) { return _mm256_castps_si256(a); }
+		static FORCEINLINE FFloat AsFloat(FInt a) { return _mm256_castsi256_ps(a); }
+
+		static FORCEINLINE FInt AddInt(FInt a, FInt b) { return _mm256_add_epi32(a, b); }
+		static FORCEINLINE FInt SubInt(FInt a, FInt b) { return _mm256_sub_epi32(a, b); }
+		static FORCEINLINE FInt AndInt(FInt a, FInt b) { return _mm256_and_si256(a, b); }
+		static FORCEINLINE FInt OrInt(FInt a, FInt b) { return _mm256_or_si256(a, b); }
+		template <int Shift> static FORCEINLINE FInt ShiftLeftInt(FInt a) { return _mm256_slli_epi32(a, Shift); }
+		template <int Shift> static FORCEINLINE FInt ShiftRightInt(FInt a) { return _mm256_srli_epi32(a, Shift); }
+
+		static FORCEINLINE FMask Less(FFloat a, FFloat b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+		static FORCEINLINE FMask EqualInt(FInt a, FInt b) { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)); }
+		static FORCEINLINE FFloat Select(FMask mask, FFloat ifTrue, FFloat ifFalse) { return _mm256_blendv_ps(ifFalse, ifTrue, mask); }
+	};
+
+	#include "OceanVectorMathKernels.inl"
+}
+OCEAN_END_TARGET()
+
+
+OCEAN_BEGIN_TARGET("avx512f")
+namespace OceanVectorMathAVX512
+{
+	struct FVec
+	{
+		using FFloat = __m512;
+		using FInt = __m512i;
+		// One bit per lane
+		using FMask = __mmask16;
+		static constexpr int Width = 16;
+
+		static FORCEINLINE FFloat Load(const float* data) { return _mm512_loadu_ps(data); }
+		static FORCEINLINE void Store(float* data, FFloat value) { _mm512_storeu_ps(data, value); }
+
+		static FORCEINLINE void LoadComplex(const float* data, FFloat& re, FFloat& im)
+		{
+			const FInt evenIndices = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+			const FInt oddIndices = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+			const FFloat low = _mm512_loadu_ps(data);
+			const FFloat high = _mm512_loadu_ps(data + 16);
+			re = _mm512_permutex2var_ps(low, evenIndices, high);
+			im = _mm512_permutex2var_ps(low, oddIndices, high);
+		}
+		static FORCEINLINE void StoreComplex(float* data, FFloat re, FFloat im)
+		{
+			const FInt lowIndices = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+			const FInt highIndices = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+			_mm512_storeu_ps(data, _mm512_permutex2var_ps(re, lowIndices, im));
+			_mm512_storeu_ps(data + 16, _mm512_permutex2var_ps(re, highIndices, im));
+		}
+
+		static FORCEINLINE FFloat Set(float value) { return _mm512_set1_ps(value); }
+		static FORCEINLINE FInt SetInt(int32 value) { return _mm512_set1_epi32(value); }
+
+		static FORCEINLINE FFloat Add(FFloat a, FFloat b) { return _mm512_add_ps(a, b); }
+		static FORCEINLINE FFloat Sub(FFloat a, FFloat b) { return _mm512_sub_ps(a, b); }
+		static FORCEINLINE FFloat Mul(FFloat a, FFloat b) { return _mm512_mul_ps(a, b); }
+		static FORCEINLINE FFloat MulAdd(FFloat a, FFloat b, FFloat c) { return _mm512_fmadd_ps(a, b, c); }
+		static FORCEINLINE FFloat Min(FFloat a, FFloat b) { return _mm512_min_ps(a, b); }
+		static FORCEINLINE FFloat Max(FFloat a, FFloat b) { return _mm512_max_ps(a, b); }
+		static FORCEINLINE FFloat Sqrt(FFloat a) { return _mm512_sqrt_ps(a); }
+		static FORCEINLINE FFloat Round(FFloat a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+		static FORCEINLINE FFloat Floor(FFloat a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+		// _mm512_xor_ps needs AVX-512DQ
+		static FORCEINLINE FFloat Xor(FFloat a, FFloat b) { return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_castps_si512(b))); }
+
+		static FORCEINLINE FInt ToInt(FFloat a) { return _mm512_cvttps_epi32(a); }
+		static FORCEINLINE FFloat ToFloat(FInt a) { return _mm512_cvtepi32_ps(a); }
+		static FORCEINLINE FInt AsInt(FFloat a) { return _mm512_castps_si512(a); }
+		static FORCEINLINE FFloat AsFloat(FInt a) { return _mm512_castsi512_ps(a); }
+
+		static FORCEINLINE FInt AddInt(FInt a, FInt b) { return _mm512_add_epi32(a, b); }
+		static FORCEINLINE FInt SubInt(FInt a, FInt b) { return _mm512_sub_epi32(a, b); }
+		static FORCEINLINE FInt AndInt(FInt a, FInt b) { return _mm512_and_si512(a, b); }
+		static FORCEINLINE FInt OrInt(FInt a, FInt b) { return _mm512_or_si512(a, b); }
+		template <int Shift> static FORCEINLINE FInt ShiftLeftInt(FInt a) { return _mm512_slli_epi32(a, Shift); }
+		template <int Shift> static FORCEINLINE FInt ShiftRightInt(FInt a) { return _mm512_srli_epi32(a, Shift); }
+
+		static FORCEINLINE FMask Less(FFloat a, FFloat b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+		static FORCEINLINE FMask EqualInt(FInt a, FInt b) { return _mm512_cmpeq_epi32_mask(a, b); }
+		static FORCEINLINE FFloat Select(FMask mask, FFloat ifTrue, FFloat ifFalse) { return _mm512_mask_blend_ps(mask, ifFalse, ifTrue); }
+	};
+
+	#include "OceanVectorMathKernels.inl"
+}
+OCEAN_END_TARGET()
+
+#endif
+
+
+namespace
+{
+#if PLATFORM_CPU_X86_FAMILY
+	void Cpuid(int leaf, int subleaf, uint32 registers[4])
+	{
+	#if defined(_MSC_VER) && !defined(__clang__)
+		__cpuidex(reinterpret_cast<int*>(registers), leaf, subleaf);
+	#else
+		__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+	#endif
+	}
+
+	// Register state the OS saves on context switches, the wide registers are unusable without it
+	uint64 ReadXcr0()
+	{
+	#if defined(_MSC_VER) && !defined(__clang__)
+		return _xgetbv(0);
+	#else
+		uint32 low, high;
+		__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		return ((uint64)high << 32) | low;
+	#endif
+	}
+#endif
+
+	OceanVectorMath::EIsa DetectIsa()
+	{
+#if PLATFORM_CPU_X86_FAMILY
+		uint32 registers[4];
+		Cpuid(0, 0, registers);
+		const uint32 maxLeaf = registers[0];
+
+		Cpuid(1, 0, registers);
+		const bool sse41 = registers[2] & (1 << 19);
+		const bool fma = registers[2] & (1 << 12);
+		const bool osxsave = registers[2] & (1 << 27);
+		const bool avx = registers[2] & (1 << 28);
+
+		if (!sse41)
+			return OceanVectorMath::EIsa::Scalar;
+
+		if (!osxsave || !avx || !fma || maxLeaf < 7)
+			return OceanVectorMath::EIsa::SSE4;
+
+		// XMM and YMM state, then opmask and both halves of ZMM state
+		const uint64 xcr0 = ReadXcr0();
+		if ((xcr0 & 0x06) != 0x06)
+			return OceanVectorMath::EIsa::SSE4;
+
+		Cpuid(7, 0, registers);
+		const bool avx2 = registers[1] & (1 << 5);
+		const bool avx512f = registers[1] & (1 << 16);
+
+		if (!avx2)
+			return OceanVectorMath::EIsa::SSE4;
+
+		return avx512f && (xcr0 & 0xE6) == 0xE6 ? OceanVectorMath::EIsa::AVX512 : OceanVectorMath::EIsa::AVX2;
+#else
+		return OceanVectorMath::EIsa::Scalar;
+#endif
+	}
+
+	const FKernelTable& GetKernels(OceanVectorMath::EIsa isa)
+	{
+		switch (isa)
+		{
+#if PLATFORM_CPU_X86_FAMILY
+		case OceanVectorMath::EIsa::SSE4: return OceanVectorMathSSE4::Kernels;
+		case OceanVectorMath::EIsa::AVX2: return OceanVectorMathAVX2::Kernels;
+		case OceanVectorMath::EIsa::AVX512: return OceanVectorMathAVX512::Kernels;
+#endif
+		default: return OceanVectorMathScalar::Kernels;
+		}
+	}
+
+	std::atomic<const FKernelTable*> GActiveKernels { nullptr };
+	std::atomic<OceanVectorMath::EIsa> GActiveIsa { OceanVectorMath::EIsa::Scalar };
+
+	// First use picks the widest set, checking it against the reference once outside shipping builds. The first
+	// users are usually several pool workers at once, the static makes them wait for a single selection.
+	const FKernelTable& ActiveKernels()
+	{
+		static const bool bSelected = []()
+		{
+			if (!GActiveKernels.load(std::memory_order_acquire))
+			{
+				OceanVectorMath::SetIsa(OceanVectorMath::GetSupportedIsa());
+			}
+			return true;
+		}();
+		(void)bSelected;
+
+		return *GActiveKernels.load(std::memory_order_acquire);
+	}
+
+	// Reduces by quarter turns exactly in double so results at multiples of pi / 2 are exact zeros
+	void SinCosTurnsReference(double turns, double& sinOut, double& cosOut)
+	{
+		const double quarter = std::round(4.0 * (turns - std::round(turns)));
+		const double radians = 2.0 * UE_DOUBLE_PI * (turns - std::round(turns) - 0.25 * quarter);
+		const double sinR = std::sin(radians);
+		const double cosR = std::cos(radians);
+
+		switch ((int)quarter & 3)
+		{
+		case 0: sinOut = sinR; cosOut = cosR; break;
+		case 1: sinOut = cosR; cosOut = -sinR; break;
+		case 2: sinOut = -sinR; cosOut = -cosR; break;
+		default: sinOut = -cosR; cosOut = sinR; break;
+		}
+	}
+
+	float UlpError(float value, double reference)
+	{
+		const float rounded = (float)reference;
+		const float ulp = FMath::Max(std::nextafter(FMath::Abs(rounded), FLT_MAX) - FMath::Abs(rounded), FLT_MIN);
+		return (float)(FMath::Abs(value - reference) / ulp);
+	}
+}
+
+
+OceanVectorMath::EIsa OceanVectorMath::GetSupportedIsa()
+{
+	static const EIsa supported = DetectIsa();
+	return supported;
+}
+
+
+OceanVectorMath::EIsa OceanVectorMath::GetIsa()
+{
+	ActiveKernels();
+	return GActiveIsa.load();
+}
+
+
+void OceanVectorMath::SetIsa(EIsa isa)
+{
+	isa = (EIsa)FMath::Min((uint8)isa, (uint8)GetSupportedIsa());
+
+#if !UE_BUILD_SHIPPING
+	if (isa != EIsa::Scalar)
+	{
+		const FAccuracyReport report = CheckAgainstReference(isa, 4096);
+		if (report.SinCosMaxUlp > MaxUlp || report.SinCosTurnsMaxUlp > MaxUlp || report.LogMaxUlp > MaxUlp || report.SqrtMaxUlp > MaxUlp
+			|| report.SinCosMaxAbsError > MaxSinCosAbsError || report.EvolveSpectrumMaxRelativeError > MaxEvolveSpectrumRelativeError)
+		{
+			UE_LOG(LogOcean, Error, TEXT("OceanVectorMath: %s kernels exceed their error bounds, using Scalar"), GetIsaName(isa));
+			isa = EIsa::Scalar;
+		}
+	}
+#endif
+
+	GActiveIsa = isa;
+	GActiveKernels.store(&GetKernels(isa), std::memory_order_release);
+
+	UE_LOG(LogOcean, Log, TEXT("OceanVectorMath: using %s kernels"), GetIsaName(isa));
+}
+
+
+const TCHAR* OceanVectorMath::GetIsaName(EIsa isa)
+{
+	switch (isa)
+	{
+	case EIsa::SSE4: return TEXT("SSE4.1");
+	case EIsa::AVX2: return TEXT("AVX2");
+	case EIsa::AVX512: return TEXT("AVX-512");
+	default: return TEXT("Scalar");
+	}
+}
+
+
+void OceanVectorMath::SplitFrequency(float frequency, float& frequencyHi, float& frequencyLo)
+{
+	frequencyHi = FMath::AsFloat(FMath::AsUInt(frequency) & 0xFFFFF000);
+	frequencyLo = frequency - frequencyHi;
+}
+
+
+void OceanVectorMath::SinCos(const float* x, float* sinOut, float* cosOut, int count)
+{
+	ActiveKernels().SinCos(x, sinOut, cosOut, count);
+}
+
+
+void OceanVectorMath::SinCosTurns(const float* turns, float* sinOut, float* cosOut, int count)
+{
+	ActiveKernels().SinCosTurns(turns, sinOut, cosOut, count);
+}
+
+
+void OceanVectorMath::Log(const float* x, float* out, int count)
+{
+	ActiveKernels().Log(x, out, count);
+}
+
+
+void OceanVectorMath::Sqrt(const float* x, float* out, int count)
+{
+	ActiveKernels().Sqrt(x, out, count);
+}
+
+
+void OceanVectorMath::NoiseRow(float firstX, float y, float* out, int count)
+{
+	ActiveKernels().NoiseRow(firstX, y, out, count);
+}
+
+
+void OceanVectorMath::GaussRandom(const float* uniform0, const float* uniform1, FOceanComplex* out, int count)
+{
+	ActiveKernels().GaussRandom(uniform0, uniform1, out, count);
+}
+
+
+void OceanVectorMath::EvolveSpectrum(const FSpectrumBins& bins, float timeHi, float timeLo, FOceanComplex* outX, FOceanComplex* outY, FOceanComplex* outZ, int count)
+{
+	ActiveKernels().EvolveSpectrum(bins, timeHi, timeLo, outX, outY, outZ, count);
+}
+
+
+OceanVectorMath::FAccuracyReport OceanVectorMath::CheckAgainstReference(EIsa isa, int samples)
+{
+	const FKernelTable& kernels = GetKernels((EIsa)FMath::Min((uint8)isa, (uint8)GetSupportedIsa()));
+	FRandomStream random(0x0CEA4);
+
+	FAccuracyReport report {};
+	report.Isa = isa;
+
+	TArray<float> input, sinOut, cosOut;
+	input.SetNumUninitialized(samples);
+	sinOut.SetNumUninitialized(samples);
+	cosOut.SetNumUninitialized(samples);
+
+	// Ulp over a few periods, absolute error over the whole reduction range
+	for (int i = 0; i < samples; i++) input[i] = random.FRandRange(-4.0f * UE_PI, 4.0f * UE_PI);
+	kernels.SinCos(input.GetData(), sinOut.GetData(), cosOut.GetData(), samples);
+	for (int i = 0; i < samples; i++)
+	{
+		report.SinCosMaxUlp = FMath::Max3(report.SinCosMaxUlp, UlpError(sinOut[i], std::sin((double)input[i])), UlpError(cosOut[i], std::cos((double)input[i])));
+	}
+
+	for (int i = 0; i < samples; i++) input[i] = random.FRandRange(-4e5f, 4e5f);
+	kernels.SinCos(input.GetData(), sinOut.GetData(), cosOut.GetData(), samples);
+	for (int i = 0; i < samples; i++)
+	{
+		const double sinError = FMath::Abs(sinOut[i] - std::sin((double)input[i]));
+		const double cosError = FMath::Abs(cosOut[i] - std::cos((double)input[i]));
+		report.SinCosMaxAbsError = FMath::Max3(report.SinCosMaxAbsError, (float)sinError, (float)cosError);
+	}
+
+	for (int i = 0; i < samples; i++) input[i] = random.FRandRange(-1000.0f, 1000.0f);
+	kernels.SinCosTurns(input.GetData(), sinOut.GetData(), cosOut.GetData(), samples);
+	for (int i = 0; i < samples; i++)
+	{
+		double sinReference, cosReference;
+		SinCosTurnsReference(input[i], sinReference, cosReference);
+		report.SinCosTurnsMaxUlp = FMath::Max3(report.SinCosTurnsMaxUlp, UlpError(sinOut[i], sinReference), UlpError(cosOut[i], cosReference));
+	}
+
+	// Exponents across the whole normal range
+	for (int i = 0; i < samples; i++) input[i] = FMath::Pow(2.0f, random.FRandRange(-125.0f, 127.0f));
+	kernels.Log(input.GetData(), sinOut.GetData(), samples);
+	kernels.Sqrt(input.GetData(), cosOut.GetData(), samples);
+	for (int i = 0; i < samples; i++)
+	{
+		report.LogMaxUlp = FMath::Max(report.LogMaxUlp, UlpError(sinOut[i], std::log((double)input[i])));
+		report.SqrtMaxUlp = FMath::Max(report.SqrtMaxUlp, UlpError(cosOut[i], std::sqrt((double)input[i])));
+	}
+
+	// A synthetic spectrum evolved at a large time
+	TArray<FOceanComplex> positive, negative, outX, outY, outZ, referenceX, referenceY, referenceZ;
+	TArray<float> frequencyHi, frequencyLo;
+	TArray<FVector2f> unitWaveVector;
+	for (TArray<FOceanComplex>* complexArray : { &positive, &negative, &outX, &outY, &outZ, &referenceX, &referenceY, &referenceZ })
+	{
+		complexArray->SetNumUninitialized(samples);
+	}
+	frequencyHi.SetNumUninitialized(samples);
+	frequencyLo.SetNumUninitialized(samples);
+	unitWaveVector.SetNumUninitialized(samples);
+
+	for (int i = 0; i < samples; i++)
+	{
+		positive[i] = { random.FRandRange(-1.0f, 1.0f), random.FRandRange(-1.0f, 1.0f) };
+		negative[i] = { random.FRandRange(-1.0f, 1.0f), random.FRandRange(-1.0f, 1.0f) };
+
+		SplitFrequency(random.FRandRange(0.0f, 2.0f), frequencyHi[i], frequencyLo[i]);
+
+		const float angle = random.FRandRange(0.0f, 2.0f * UE_PI);
+		unitWaveVector[i] = FVector2f(FMath::Cos(angle), FMath::Sin(angle));
+	}
+
+	const FSpectrumBins bins { positive.GetData(), negative.GetData(), frequencyHi.GetData(), frequencyLo.GetData(), unitWaveVector.GetData() };
+	const float timeHi = 86016.0f;
+	const float timeLo = 0.123f;
+
+	OceanVectorMathScalar::EvolveSpectrum(bins, timeHi, timeLo, referenceX.GetData(), referenceY.GetData(), referenceZ.GetData(), samples);
+
+	// Timed on the second run so first-touch page faults of the outputs are not counted
+	kernels.EvolveSpectrum(bins, timeHi, timeLo, outX.GetData(), outY.GetData(), outZ.GetData(), samples);
+	const double start = FPlatformTime::Seconds();
+	kernels.EvolveSpectrum(bins, timeHi, timeLo, outX.GetData(), outY.GetData(), outZ.GetData(), samples);
+	const double seconds = FPlatformTime::Seconds() - start;
+
+	float maxDifference = 0.0f;
+	float maxHeight = 0.0f;
+	auto compare = [&maxDifference](const FOceanComplex& value, const FOceanComplex& reference)
+	{
+		maxDifference = FMath::Max3(maxDifference, FMath::Abs(value.Real - reference.Real), FMath::Abs(value.Imag - reference.Imag));
+	};
+
+	for (int i = 0; i < samples; i++)
+	{
+		compare(outX[i], referenceX[i]);
+		compare(outY[i], referenceY[i]);
+		compare(outZ[i], referenceZ[i]);
+		maxHeight = FMath::Max3(maxHeight, FMath::Abs(referenceY[i].Real), FMath::Abs(referenceY[i].Imag));
+	}
+	report.EvolveSpectrumMaxRelativeError = maxDifference / FMath::Max(maxHeight, UE_SMALL_NUMBER);
+	report.EvolveSpectrumNsPerBin = (float)(seconds * 1e9 / samples);
+
+	UE_LOG(LogOcean, Log, TEXT("OceanVectorMath %s: sincos %.2f ulp (abs %.2g up to 4e5), turns %.2f ulp, log %.2f ulp, sqrt %.2f ulp, spectrum %.2g relative, %.2f ns per bin"),
+		GetIsaName(isa), report.SinCosMaxUlp, report.SinCosMaxAbsError, report.SinCosTurnsMaxUlp, report.LogMaxUlp, report.SqrtMaxUlp,
+		report.EvolveSpectrumMaxRelativeError, report.EvolveSpectrumNsPerBin);
+
+	return report;
+}
+
+
+static FAutoConsoleCommand GOceanVectorMathCheckCommand(
+	TEXT("Ocean.VectorMath.Check"),
+	TEXT("Checks the SIMD math kernels of every supported instruction set against the scalar reference"),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		for (uint8 isa = (uint8)OceanVectorMath::EIsa::Scalar; isa <= (uint8)OceanVectorMath::GetSupportedIsa(); isa++)
+		{
+			OceanVectorMath::CheckAgainstReference((OceanVectorMath::EIsa)isa);
+		}
+	})
+);
\ No newline at end of file
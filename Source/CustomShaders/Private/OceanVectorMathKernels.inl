@@ -0,0 +1,324 @@
+// Kernels shared by every instruction set. Included by OceanVectorMath.cpp once per set, inside a namespace that
+// defines FVec (see the SSE4 one for the interface) and within that set's target region, so no include guard.
+
+using FFloat = FVec::FFloat;
+using FInt = FVec::FInt;
+using FMask = FVec::FMask;
+constexpr int Width = FVec::Width;
+
+
+// sin and cos of r in [-pi/4, pi/4] (Cephes sinf/cosf polynomials), rotated by j quarter turns
+FORCEINLINE void SinCosQuadrant(FFloat r, FInt j, FFloat& sinOut, FFloat& cosOut)
+{
+	const FFloat z = FVec::Mul(r, r);
+
+	FFloat sinR = FVec::MulAdd(FVec::Set(-1.9515295891e-4f), z, FVec::Set(8.3321608736e-3f));
+	sinR = FVec::MulAdd(sinR, z, FVec::Set(-1.6666654611e-1f));
+	sinR = FVec::MulAdd(sinR, FVec::Mul(z, r), r);
+
+	FFloat cosR = FVec::MulAdd(FVec::Set(2.443315711809948e-5f), z, FVec::Set(-1.388731625493765e-3f));
+	cosR = FVec::MulAdd(cosR, z, FVec::Set(4.166664568298827e-2f));
+	cosR = FVec::Mul(cosR, FVec::Mul(z, z));
+	cosR = FVec::Sub(cosR, FVec::Mul(FVec::Set(0.5f), z));
+	cosR = FVec::Add(cosR, FVec::Set(1.0f));
+
+	// Odd quadrants swap sin and cos, sin is negative in quadrants 2 and 3 and cos in 1 and 2
+	const FMask swap = FVec::EqualInt(FVec::AndInt(j, FVec::SetInt(1)), FVec::SetInt(1));
+	const FFloat sinSign = FVec::AsFloat(FVec::ShiftLeftInt<30>(FVec::AndInt(j, FVec::SetInt(2))));
+	const FFloat cosSign = FVec::AsFloat(FVec::ShiftLeftInt<30>(FVec::AndInt(FVec::AddInt(j, FVec::SetInt(1)), FVec::SetInt(2))));
+
+	sinOut = FVec::Xor(FVec::Select(swap, cosR, sinR), sinSign);
+	cosOut = FVec::Xor(FVec::Select(swap, sinR, cosR), cosSign);
+}
+
+
+// Cody-Waite reduction by pi/2 split into parts of at most 6 significant bits, so every j * part and every partial
+// difference is exact while j < 2^18 (|x| < 4e5, which covers the noise hash at N = 2048). The last part carries the
+// rest of pi/2 to float precision.
+FORCEINLINE void SinCosRadians(FFloat x, FFloat& sinOut, FFloat& cosOut)
+{
+	const FFloat j = FVec::Round(FVec::Mul(x, FVec::Set(0.636619772f)));
+
+	FFloat r = FVec::Sub(x, FVec::Mul(j, FVec::Set(1.5625f)));
+	r = FVec::Sub(r, FVec::Mul(j, FVec::Set(8.056640625e-3f)));
+	r = FVec::Sub(r, FVec::Mul(j, FVec::Set(2.3651123046875e-4f)));
+	r = FVec::Sub(r, FVec::Mul(j, FVec::Set(3.159046173095703125e-6f)));
+	r = FVec::Sub(r, FVec::Mul(j, FVec::Set(1.5893254712295857e-8f)));
+
+	SinCosQuadrant(r, FVec::ToInt(j), sinOut, cosOut);
+}
+
+
+// Whole turns and quarter turns are removed exactly, only the final scaling to radians rounds
+FORCEINLINE void SinCosOfTurns(FFloat turns, FFloat& sinOut, FFloat& cosOut)
+{
+	const FFloat t = FVec::Sub(turns, FVec::Round(turns));
+	const FFloat j = FVec::Round(FVec::Mul(t, FVec::Set(4.0f)));
+	const FFloat r = FVec::Mul(FVec::Sub(t, FVec::Mul(j, FVec::Set(0.25f))), FVec::Set(2.0f * UE_PI));
+
+	SinCosQuadrant(r, FVec::ToInt(j), sinOut, cosOut);
+}
+
+
+// Cephes logf for positive normal x
+FORCEINLINE FFloat LogPositive(FFloat x)
+{
+	const FInt bits = FVec::AsInt(x);
+
+	// x = m 2^e with m in [sqrt(1/2), sqrt(2)), then log(x) = log1p(m - 1) + e log(2)
+	FFloat e = FVec::ToFloat(FVec::SubInt(FVec::ShiftRightInt<23>(bits), FVec::SetInt(126)));
+	FFloat m = FVec::AsFloat(FVec::OrInt(FVec::AndInt(bits, FVec::SetInt(0x007FFFFF)), FVec::SetInt(0x3F000000)));
+
+	const FMask belowSqrtHalf = FVec::Less(m, FVec::Set(0.707106781f));
+	e = FVec::Select(belowSqrtHalf, FVec::Sub(e, FVec::Set(1.0f)), e);
+	m = FVec::Sub(FVec::Select(belowSqrtHalf, FVec::Add(m, m), m), FVec::Set(1.0f));
+
+	const FFloat z = FVec::Mul(m, m);
+
+	FFloat y = FVec::MulAdd(FVec::Set(7.0376836292e-2f), m, FVec::Set(-1.1514610310e-1f));
+	y = FVec::MulAdd(y, m, FVec::Set(1.1676998740e-1f));
+	y = FVec::MulAdd(y, m, FVec::Set(-1.2420140846e-1f));
+	y = FVec::MulAdd(y, m, FVec::Set(1.4249322787e-1f));
+	y = FVec::MulAdd(y, m, FVec::Set(-1.6668057665e-1f));
+	y = FVec::MulAdd(y, m, FVec::Set(2.0000714765e-1f));
+	y = FVec::MulAdd(y, m, FVec::Set(-2.4999993993e-1f));
+	y = FVec::MulAdd(y, m, FVec::Set(3.3333331174e-1f));
+	y = FVec::Mul(FVec::Mul(y, m), z);
+
+	// log(2) split so e * 0.693359375 is exact
+	y = FVec::MulAdd(e, FVec::Set(-2.12194440e-4f), y);
+	y = FVec::Sub(y, FVec::Mul(FVec::Set(0.5f), z));
+
+	return FVec::MulAdd(e, FVec::Set(0.693359375f), FVec::Add(m, y));
+}
+
+
+// Each kernel runs full vectors, then runs itself once more on a padded copy of the remainder
+void SinCos(const float* x, float* sinOut, float* cosOut, int count)
+{
+	int i = 0;
+	for (; i + Width <= count; i += Width)
+	{
+		FFloat sinX, cosX;
+		SinCosRadians(FVec::Load(x + i), sinX, cosX);
+		FVec::Store(sinOut + i, sinX);
+		FVec::Store(cosOut + i, cosX);
+	}
+
+	if (i < count)
+	{
+		alignas(64) float xTail[Width] = {};
+		alignas(64) float sinTail[Width];
+		alignas(64) float cosTail[Width];
+
+		FMemory::Memcpy(xTail, x + i, (count - i) * sizeof(float));
+		SinCos(xTail, sinTail, cosTail, Width);
+		FMemory::Memcpy(sinOut + i, sinTail, (count - i) * sizeof(float));
+		FMemory::Memcpy(cosOut + i, cosTail, (count - i) * sizeof(float));
+	}
+}
+
+
+void SinCosTurns(const float* turns, float* sinOut, float* cosOut, int count)
+{
+	int i = 0;
+	for (; i + Width <= count; i += Width)
+	{
+		FFloat sinX, cosX;
+		SinCosOfTurns(FVec::Load(turns + i), sinX, cosX);
+		FVec::Store(sinOut + i, sinX);
+		FVec::Store(cosOut + i, cosX);
+	}
+
+	if (i < count)
+	{
+		alignas(64) float turnsTail[Width] = {};
+		alignas(64) float sinTail[Width];
+		alignas(64) float cosTail[Width];
+
+		FMemory::Memcpy(turnsTail, turns + i, (count - i) * sizeof(float));
+		SinCosTurns(turnsTail, sinTail, cosTail, Width);
+		FMemory::Memcpy(sinOut + i, sinTail, (count - i) * sizeof(float));
+		FMemory::Memcpy(cosOut + i, cosTail, (count - i) * sizeof(float));
+	}
+}
+
+
+void Log(const float* x, float* out, int count)
+{
+	int i = 0;
+	for (; i + Width <= count; i += Width)
+	{
+		FVec::Store(out + i, LogPositive(FVec::Load(x + i)));
+	}
+
+	if (i < count)
+	{
+		alignas(64) float xTail[Width];
+		alignas(64) float outTail[Width];
+
+		for (int lane = 0; lane < Width; lane++) xTail[lane] = 1.0f;
+		FMemory::Memcpy(xTail, x + i, (count - i) * sizeof(float));
+		Log(xTail, outTail, Width);
+		FMemory::Memcpy(out + i, outTail, (count - i) * sizeof(float));
+	}
+}
+
+
+void Sqrt(const float* x, float* out, int count)
+{
+	int i = 0;
+	for (; i + Width <= count; i += Width)
+	{
+		FVec::Store(out + i, FVec::Sqrt(FVec::Load(x + i)));
+	}
+
+	if (i < count)
+	{
+		alignas(64) float xTail[Width] = {};
+		alignas(64) float outTail[Width];
+
+		FMemory::Memcpy(xTail, x + i, (count - i) * sizeof(float));
+		Sqrt(xTail, outTail, Width);
+		FMemory::Memcpy(out + i, outTail, (count - i) * sizeof(float));
+	}
+}
+
+
+void NoiseRow(float firstX, float y, float* out, int count)
+{
+	alignas(64) float lanes[Width];
+	for (int lane = 0; lane < Width; lane++) lanes[lane] = (float)lane;
+
+	const FFloat ramp = FVec::Load(lanes);
+	const FFloat yTerm = FVec::Set(y * 78.233f);
+
+	int i = 0;
+	for (; i + Width <= count; i += Width)
+	{
+		// Same operation order as the scalar hash so the argument is bit identical
+		const FFloat x = FVec::Add(FVec::Set(firstX + i), ramp);
+		const FFloat argument = FVec::Add(FVec::Mul(x, FVec::Set(12.9898f)), yTerm);
+
+		FFloat sinX, cosX;
+		SinCosRadians(argument, sinX, cosX);
+
+		const FFloat value = FVec::Mul(sinX, FVec::Set(43758.5453123f));
+		FVec::Store(out + i, FVec::Sub(value, FVec::Floor(value)));
+	}
+
+	if (i < count)
+	{
+		alignas(64) float outTail[Width];
+
+		NoiseRow(firstX + i, y, outTail, Width);
+		FMemory::Memcpy(out + i, outTail, (count - i) * sizeof(float));
+	}
+}
+
+
+void GaussRandom(const float* uniform0, const float* uniform1, FOceanComplex* out, int count)
+{
+	const FFloat lower = FVec::Set(0.001f);
+	const FFloat upper = FVec::Set(1.0f);
+
+	int i = 0;
+	for (; i + Width <= count; i += Width)
+	{
+		const FFloat u = FVec::Min(FVec::Max(FVec::Load(uniform0 + i), lower), upper);
+		const FFloat v = FVec::Sqrt(FVec::Mul(FVec::Set(-2.0f), LogPositive(FVec::Min(FVec::Max(FVec::Load(uniform1 + i), lower), upper))));
+
+		// u is the angle in turns
+		FFloat sinU, cosU;
+		SinCosOfTurns(u, sinU, cosU);
+		FVec::StoreComplex(&out[i].Real, FVec::Mul(v, cosU), FVec::Mul(v, sinU));
+	}
+
+	if (i < count)
+	{
+		alignas(64) float uniform0Tail[Width] = {};
+		alignas(64) float uniform1Tail[Width] = {};
+		alignas(64) FOceanComplex outTail[Width];
+
+		FMemory::Memcpy(uniform0Tail, uniform0 + i, (count - i) * sizeof(float));
+		FMemory::Memcpy(uniform1Tail, uniform1 + i, (count - i) * sizeof(float));
+		GaussRandom(uniform0Tail, uniform1Tail, outTail, Width);
+		FMemory::Memcpy(out + i, outTail, (count - i) * sizeof(FOceanComplex));
+	}
+}
+
+
+void EvolveSpectrum(const OceanVectorMath::FSpectrumBins& bins, float timeHi, float timeLo, FOceanComplex* outX, FOceanComplex* outY, FOceanComplex* outZ, int count)
+{
+	const FFloat tHi = FVec::Set(timeHi);
+	const FFloat tLo = FVec::Set(timeLo);
+
+	int i = 0;
+	for (; i + Width <= count; i += Width)
+	{
+		// Phase in cycles as in FourierComponentsComputeShader.usf, each product is reduced before they are summed
+		const FFloat fHi = FVec::Load(bins.FrequencyHi + i);
+		const FFloat fLo = FVec::Load(bins.FrequencyLo + i);
+
+		const FFloat cycles0 = FVec::Mul(fHi, tHi);
+		const FFloat cycles1 = FVec::Mul(fLo, tHi);
+		const FFloat cycles2 = FVec::Mul(FVec::Add(fHi, fLo), tLo);
+		const FFloat cycles = FVec::Add(FVec::Add(FVec::Sub(cycles0, FVec::Round(cycles0)), FVec::Sub(cycles1, FVec::Round(cycles1))), FVec::Sub(cycles2, FVec::Round(cycles2)));
+
+		FFloat sinWt, cosWt;
+		SinCosOfTurns(cycles, sinWt, cosWt);
+
+		FFloat positiveRe, positiveIm, negativeRe, negativeIm;
+		FVec::LoadComplex(&bins.Positive[i].Real, positiveRe, positiveIm);
+		FVec::LoadComplex(&bins.Negative[i].Real, negativeRe, negativeIm);
+
+		// h0 e + conj(h0-) conj(e) = ((p + n).re cos - (p + n).im sin, (p - n).re sin + (p - n).im cos)
+		const FFloat heightRe = FVec::Sub(FVec::Mul(FVec::Add(positiveRe, negativeRe), cosWt), FVec::Mul(FVec::Add(positiveIm, negativeIm), sinWt));
+		const FFloat heightIm = FVec::MulAdd(FVec::Sub(positiveRe, negativeRe), sinWt, FVec::Mul(FVec::Sub(positiveIm, negativeIm), cosWt));
+
+		if (outY)
+		{
+			FVec::StoreComplex(&outY[i].Real, heightRe, heightIm);
+		}
+
+		if (outX || outZ)
+		{
+			FFloat unitX, unitZ;
+			FVec::LoadComplex(&bins.UnitWaveVector[i].X, unitX, unitZ);
+
+			// -i u h = (u h.im, -u h.re)
+			const FFloat negativeHeightRe = FVec::Sub(FVec::Set(0.0f), heightRe);
+			if (outX) FVec::StoreComplex(&outX[i].Real, FVec::Mul(unitX, heightIm), FVec::Mul(unitX, negativeHeightRe));
+			if (outZ) FVec::StoreComplex(&outZ[i].Real, FVec::Mul(unitZ, heightIm), FVec::Mul(unitZ, negativeHeightRe));
+		}
+	}
+
+	if (i < count)
+	{
+		const int tail = count - i;
+
+		alignas(64) FOceanComplex positiveTail[Width] = {};
+		alignas(64) FOceanComplex negativeTail[Width] = {};
+		alignas(64) float frequencyHiTail[Width] = {};
+		alignas(64) float frequencyLoTail[Width] = {};
+		alignas(64) FVector2f unitTail[Width];
+		alignas(64) FOceanComplex outTail[3][Width];
+
+		FMemory::Memcpy(positiveTail, bins.Positive + i, tail * sizeof(FOceanComplex));
+		FMemory::Memcpy(negativeTail, bins.Negative + i, tail * sizeof(FOceanComplex));
+		FMemory::Memcpy(frequencyHiTail, bins.FrequencyHi + i, tail * sizeof(float));
+		FMemory::Memcpy(frequencyLoTail, bins.FrequencyLo + i, tail * sizeof(float));
+		FMemory::Memzero(unitTail, sizeof(unitTail));
+		FMemory::Memcpy(unitTail, bins.UnitWaveVector + i, tail * sizeof(FVector2f));
+
+		const OceanVectorMath::FSpectrumBins tailBins { positiveTail, negativeTail, frequencyHiTail, frequencyLoTail, unitTail };
+		EvolveSpectrum(tailBins, timeHi, timeLo, outX ? outTail[0] : nullptr, outY ? outTail[1] : nullptr, outZ ? outTail[2] : nullptr, Width);
+
+		if (outX) FMemory::Memcpy(outX + i, outTail[0], tail * sizeof(FOceanComplex));
+		if (outY) FMemory::Memcpy(outY + i, outTail[1], tail * sizeof(FOceanComplex));
+		if (outZ) FMemory::Memcpy(outZ + i, outTail[2], tail * sizeof(FOceanComplex));
+	}
+}
+
+
+const FKernelTable Kernels { &SinCos, &SinCosTurns, &Log, &Sqrt, &NoiseRow, &GaussRandom, &EvolveSpectrum };
\ No newline at end of file
@@ -0,0 +1,260 @@
+#include "OceanWorkerPool.h"
+
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/ScopeLock.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <windows.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#elif PLATFORM_LINUX
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+
+// Set on pool threads while they run tasks, a ParallelFor from there would wait on itself
+static thread_local bool GIsRunningOceanTask = false;
+
+
+class OceanWorkerPool::FWorker : public FRunnable
+{
+public:
+	FWorker(OceanWorkerPool& pool, int workerIndex, uint64 affinityMask)
+		: mPool(pool), mWorkerIndex(workerIndex)
+	{
+		mWakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+		mThread = FRunnableThread::Create(this, TEXT("OceanWorker"), 0, TPri_AboveNormal, affinityMask);
+	}
+
+	virtual ~FWorker() override
+	{
+		mStopping = true;
+		mWakeEvent->Trigger();
+		mThread->Kill(true);
+		delete mThread;
+		
+		FPlatformProcess::ReturnSynchEventToPool(mWakeEvent);
+	}
+
+	void Wake()
+	{
+		mWakeEvent->Trigger();
+	}
+
+	virtual uint32 Run() override
+	{
+		while (true)
+		{
+			mWakeEvent->Wait();
+			
+			if (mStopping)
+				return 0;
+
+			mPool.RunTasks(mWorkerIndex);
+		}
+	}
+
+private:
+	OceanWorkerPool& mPool;
+	int mWorkerIndex;
+	FEvent* mWakeEvent;
+	FRunnableThread* mThread;
+	std::atomic<bool> mStopping { false };
+};
+
+
+OceanWorkerPool::OceanWorkerPool(int numWorkers)
+{
+	numWorkers = FMath::Clamp(numWorkers, 1, MaxWorkers);
+	mDoneEvent = FPlatformProcess::GetSynchEventFromPool(false);
+
+	const TArray<FCore> cores = QueryPhysicalCores();
+	for (int i = 0; i < numWorkers; i++)
+	{
+		mWorkers.Add(new FWorker(*this, i, cores[i % cores.Num()].AffinityMask));
+	}
+}
+
+
+OceanWorkerPool::~OceanWorkerPool()
+{
+	for (FWorker* worker : mWorkers)
+	{
+		delete worker;
+	}
+	
+	FPlatformProcess::ReturnSynchEventToPool(mDoneEvent);
+}
+
+
+OceanWorkerPool& OceanWorkerPool::Get()
+{
+	static OceanWorkerPool pool(QueryPhysicalCores().Num());
+	return pool;
+}
+
+
+TArray<OceanWorkerPool::FCore> OceanWorkerPool::QueryPhysicalCores()
+{
+	TArray<FCore> cores;
+
+#if PLATFORM_WINDOWS
+	// Processor group 0 only, thread affinity masks can't address the others
+	DWORD length = 0;
+	GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+
+	TArray<uint8> buffer;
+	buffer.SetNumUninitialized(length);
+	if (length > 0 && GetLogicalProcessorInformationEx(RelationAll, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buffer.GetData(), &length))
+	{
+		TArray<TPair<uint64, int>> nodes;
+
+		for (DWORD offset = 0; offset < length; )
+		{
+			const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info = (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)(buffer.GetData() + offset);
+
+			if (info->Relationship == RelationProcessorCore && info->Processor.GroupMask[0].Group == 0)
+			{
+				cores.Add({ (uint64)info->Processor.GroupMask[0].Mask, 0 });
+			}
+			else if (info->Relationship == RelationNumaNode && info->NumaNode.GroupMask.Group == 0)
+			{
+				nodes.Add({ (uint64)info->NumaNode.GroupMask.Mask, (int)info->NumaNode.NodeNumber });
+			}
+
+			offset += info->Size;
+		}
+
+		for (FCore& core : cores)
+		{
+			for (const TPair<uint64, int>& node : nodes)
+			{
+				if (core.AffinityMask & node.Key)
+				{
+					core.Node = node.Value;
+				}
+			}
+		}
+	}
+#elif PLATFORM_LINUX
+	// Logical processors with the same package and core id are SMT siblings of one core
+	auto readId = [](int cpu, const char* name, int& id)
+	{
+		char path[128];
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+
+		FILE* file = fopen(path, "r");
+		if (!file)
+			return false;
+
+		const bool read = fscanf(file, "%d", &id) == 1;
+		fclose(file);
+		return read;
+	};
+
+	// Package in the high, core id in the low half
+	TArray<int64> coreKeys;
+	for (int cpu = 0; cpu < 64; cpu++)
+	{
+		int package, coreId;
+		if (!readId(cpu, "physical_package_id", package) || !readId(cpu, "core_id", coreId))
+			continue;
+
+		const int64 key = ((int64)package << 32) | (uint32)coreId;
+		int index = coreKeys.Find(key);
+		if (index == INDEX_NONE)
+		{
+			index = coreKeys.Add(key);
+			cores.AddDefaulted();
+
+			for (int node = 0; node < 64; node++)
+			{
+				char path[128];
+				snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, node);
+				if (access(path, F_OK) == 0)
+				{
+					cores[index].Node = node;
+					break;
+				}
+			}
+		}
+
+		cores[index].AffinityMask |= (uint64)1 << cpu;
+	}
+#endif
+
+	// Unknown topology, fall back to one logical processor per worker
+	if (cores.IsEmpty())
+	{
+		const int numCores = FMath::Clamp(FPlatformMisc::NumberOfCores(), 1, MaxWorkers);
+		for (int i = 0; i < numCores; i++)
+		{
+			cores.Add({ (uint64)1 << i, 0 });
+		}
+	}
+
+	// Consecutive workers share a node
+	cores.StableSort([](const FCore& a, const FCore& b) { return a.Node < b.Node; });
+
+	if (cores.Num() > MaxWorkers)
+	{
+		cores.SetNum(MaxWorkers);
+	}
+
+	return cores;
+}
+
+
+void OceanWorkerPool::ParallelFor(int numTasks, TFunctionRef<void(int task)> body, int tasksPerField)
+{
+	if (numTasks <= 0)
+		return;
+
+	checkf(!GIsRunningOceanTask, TEXT("OceanWorkerPool::ParallelFor called from inside a task"));
+
+	FScopeLock lock(&mJobLock);
+
+	mBody = &body;
+	mNumTasks = numTasks;
+	mTasksPerField = tasksPerField > 0 ? FMath::Min(tasksPerField, numTasks) : numTasks;
+
+	// Workers without a tile in any field are not woken
+	const int wokenWorkers = FMath::Min(mTasksPerField, GetNumWorkers());
+	mPendingWorkers = wokenWorkers;
+	
+	for (int i = 0; i < wokenWorkers; i++)
+	{
+		mWorkers[i]->Wake();
+	}
+
+	mDoneEvent->Wait();
+
+	mBody = nullptr;
+}
+
+
+void OceanWorkerPool::RunTasks(int workerIndex)
+{
+	GIsRunningOceanTask = true;
+
+	for (int fieldStart = 0; fieldStart < mNumTasks; fieldStart += mTasksPerField)
+	{
+		const int fieldEnd = FMath::Min(fieldStart + mTasksPerField, mNumTasks);
+
+		for (int task = fieldStart + workerIndex; task < fieldEnd; task += GetNumWorkers())
+		{
+			(*mBody)(task);
+		}
+	}
+
+	GIsRunningOceanTask = false;
+
+	if (--mPendingWorkers == 0)
+	{
+		mDoneEvent->Trigger();
+	}
+}
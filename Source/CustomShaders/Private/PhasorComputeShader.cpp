@@ -0,0 +1,4 @@
+#include "PhasorComputeShader.h"
+
+
+IMPLEMENT_GLOBAL_SHADER(FPhasorComputeShader, "/CustomShaders/PhasorComputeShader.usf", "MainComputeShader", SF_Compute);
\ No newline at end of file
@@ -0,0 +1,4 @@
+#include "SpectrumResampleComputeShader.h"
+
+
+IMPLEMENT_GLOBAL_SHADER(FSpectrumResampleComputeShader, "/CustomShaders/SpectrumResampleComputeShader.usf", "MainComputeShader", SF_Compute);
\ No newline at end of file
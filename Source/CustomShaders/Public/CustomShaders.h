@@ -3,6 +3,8 @@
 #include "CoreMinimal.h"
 #include "Modules/ModuleManager.h"
 
+CUSTOMSHADERS_API DECLARE_LOG_CATEGORY_EXTERN(LogOcean, Log, All);
+
 class FCustomShadersModule : public IModuleInterface
 {
 public:
@@ -4,6 +4,7 @@
 #include "DataDrivenShaderPlatformInfo.h"
 #include "ShaderParameterStruct.h"
 #include "GlobalShader.h"
+#include "ShaderPermutation.h"
 
 #define NUM_THREADS_PER_GROUP_DIMENSION 32
 
@@ -14,6 +15,13 @@ public:
 	DECLARE_GLOBAL_SHADER(FFourierComponentsComputeShader);
 
 	SHADER_USE_PARAMETER_STRUCT(FFourierComponentsComputeShader, FGlobalShader);
+
+	// Reads exp(iwt) and the unit wave vector from the phasor/dispersion tables instead of evaluating them per bin
+	class FUsePhasors : SHADER_PERMUTATION_BOOL("USE_PHASORS");
+	// Channels nobody reads are neither evaluated nor written, their UAVs may be left unbound
+	class FOutputHeight : SHADER_PERMUTATION_BOOL("OUTPUT_HEIGHT");
+	class FOutputHorizontal : SHADER_PERMUTATION_BOOL("OUTPUT_HORIZONTAL");
+	using FPermutationDomain = TShaderPermutationDomain<FUsePhasors, FOutputHeight, FOutputHorizontal>;
 	
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
 		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<FVector4>, FourierComponentsX)
@@ -21,6 +29,8 @@ public:
 		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<FVector4>, FourierComponentsZ)
 		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<FVector4>, PositiveInitialSpectrum)
 		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<FVector4>, NegativeInitialSpectrum)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<FVector4>, Dispersion)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<FVector4>, Phasors)
 		SHADER_PARAMETER(float, N)
 		SHADER_PARAMETER(float, L)
 		SHADER_PARAMETER(float, t)
@@ -28,6 +38,12 @@ public:
 
 	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
+		const FPermutationDomain permutationVector(Parameters.PermutationId);
+		
+		// Writing nothing is never requested
+		if (!permutationVector.Get<FOutputHeight>() && !permutationVector.Get<FOutputHorizontal>())
+			return false;
+		
 		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
 	}
 
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <type_traits>
+
+#include "CoreMinimal.h"
+#include "Async/Async.h"
+#include "Misc/ScopeLock.h"
+
+
+// Flag shared between a request and everyone who may want to drop it. A default constructed token can never be
+// cancelled and costs nothing to copy around.
+class FOceanCancellationToken
+{
+public:
+	FOceanCancellationToken() = default;
+
+	static FOceanCancellationToken Create()
+	{
+		FOceanCancellationToken token;
+		token.mState = MakeShared<FState, ESPMode::ThreadSafe>();
+		return token;
+	}
+
+	// Also cancels every linked token
+	void Cancel() const
+	{
+		if (!mState || mState->bCancelled.exchange(true))
+			return;
+
+		TArray<FOceanCancellationToken> linked;
+		{
+			FScopeLock lock(&mState->Lock);
+			linked = MoveTemp(mState->Linked);
+		}
+
+		for (const FOceanCancellationToken& token : linked)
+		{
+			token.Cancel();
+		}
+	}
+
+	bool IsCancelled() const { return mState && mState->bCancelled.load(); }
+
+	// Cancelling this token from now on cancels other as well, right away if this one already is
+	void Link(const FOceanCancellationToken& other) const
+	{
+		if (!mState)
+			return;
+
+		{
+			FScopeLock lock(&mState->Lock);
+			if (!mState->bCancelled.load())
+			{
+				mState->Linked.Add(other);
+				return;
+			}
+		}
+
+		other.Cancel();
+	}
+
+	// Undoes Link, once other no longer needs to follow this token
+	void Unlink(const FOceanCancellationToken& other) const
+	{
+		if (!mState || !other.mState)
+			return;
+
+		FScopeLock lock(&mState->Lock);
+		mState->Linked.RemoveAllSwap([&other](const FOceanCancellationToken& token) { return token.mState == other.mState; });
+	}
+
+private:
+	struct FState
+	{
+		std::atomic<bool> bCancelled { false };
+		FCriticalSection Lock;
+		TArray<FOceanCancellationToken> Linked;
+	};
+
+	TSharedPtr<FState, ESPMode::ThreadSafe> mState;
+};
+
+
+template <typename T>
+class TOceanPromise;
+
+
+namespace OceanAsyncPrivate
+{
+	struct FUnit {};
+
+	template <typename T>
+	using TStored = std::conditional_t<std::is_void_v<T>, FUnit, T>;
+
+	template <typename T>
+	struct TState
+	{
+		FCriticalSection Lock;
+		TOptional<TStored<T>> Value;
+		TArray<TUniqueFunction<void(const TStored<T>&)>, TInlineAllocator<1>> Continuations;
+		FOceanCancellationToken Cancellation;
+	};
+
+	// co_return of coroutines returning TOceanFuture<T>, promise_type can't have both return_value and return_void
+	template <typename T, typename FPromiseType>
+	struct TReturn
+	{
+		void return_value(T value) { static_cast<FPromiseType*>(this)->Promise.SetValue(MoveTemp(value)); }
+	};
+
+	template <typename FPromiseType>
+	struct TReturn<void, FPromiseType>
+	{
+		void return_void() { static_cast<FPromiseType*>(this)->Promise.SetValue(); }
+	};
+}
+
+
+// Result of an asynchronous simulation request. Awaitable with co_await from any coroutine returning TOceanFuture,
+// which resumes on the game thread if it was suspended there and otherwise on whichever thread resolved the
+// future. Non-coroutine code can attach a continuation with Then.
+//
+// A coroutine returning TOceanFuture<T> starts running right away and resolves the future with co_return.
+// Cancelling its future cancels the futures it awaits from then on.
+template <typename T>
+class TOceanFuture
+{
+public:
+	using FValue = OceanAsyncPrivate::TStored<T>;
+
+	struct promise_type : OceanAsyncPrivate::TReturn<T, promise_type>
+	{
+		TOceanPromise<T> Promise;
+
+		TOceanFuture get_return_object() { return Promise.GetFuture(); }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+
+		// Exceptions are disabled in engine builds
+		void unhandled_exception() { check(false); }
+	};
+
+	bool IsReady() const
+	{
+		FScopeLock lock(&mState->Lock);
+		return mState->Value.IsSet();
+	}
+
+	// Only valid once IsReady
+	const FValue& Get() const
+	{
+		check(IsReady());
+		return mState->Value.GetValue();
+	}
+
+	// Calls continuation with the value once the future resolves, right away if it already has
+	void Then(TUniqueFunction<void(const FValue&)> continuation) const
+	{
+		if (!TryThen(continuation))
+		{
+			continuation(mState->Value.GetValue());
+		}
+	}
+
+	// Asks whoever resolves the future to skip the work behind it, it still resolves (e.g. as cancelled)
+	void Cancel() const { mState->Cancellation.Cancel(); }
+
+	const FOceanCancellationToken& GetCancellationToken() const { return mState->Cancellation; }
+
+	struct FAwaiter
+	{
+		const TOceanFuture& Future;
+
+		bool await_ready() const { return Future.IsReady(); }
+
+		// False, i.e. carry on without suspending, if the future resolved in the meantime. The coroutine is never
+		// resumed from inside await_suspend.
+		template <typename FPromise>
+		bool await_suspend(std::coroutine_handle<FPromise> handle) const
+		{
+			// Cancelling a coroutine's future also cancels whatever it is waiting on, until that resolves
+			FOceanCancellationToken awaiting;
+			if constexpr (requires { handle.promise().Promise.GetCancellationToken(); })
+			{
+				awaiting = handle.promise().Promise.GetCancellationToken();
+			}
+			const FOceanCancellationToken& awaited = Future.GetCancellationToken();
+			awaiting.Link(awaited);
+
+			const bool resumeOnGameThread = IsInGameThread();
+
+			TUniqueFunction<void(const FValue&)> resume = [handle, resumeOnGameThread, awaiting, awaited](const FValue&)
+			{
+				awaiting.Unlink(awaited);
+
+				if (resumeOnGameThread && !IsInGameThread())
+				{
+					AsyncTask(ENamedThreads::GameThread, [handle]() { handle.resume(); });
+				}
+				else
+				{
+					handle.resume();
+				}
+			};
+
+			if (!Future.TryThen(resume))
+			{
+				awaiting.Unlink(awaited);
+				return false;
+			}
+
+			return true;
+		}
+
+		T await_resume() const
+		{
+			if constexpr (!std::is_void_v<T>)
+			{
+				return Future.Get();
+			}
+		}
+	};
+
+	FAwaiter operator co_await() const { return FAwaiter { *this }; }
+
+private:
+	friend class TOceanPromise<T>;
+
+	// Queues continuation unless the future already resolved, continuation is left untouched then
+	bool TryThen(TUniqueFunction<void(const FValue&)>& continuation) const
+	{
+		FScopeLock lock(&mState->Lock);
+		if (mState->Value.IsSet())
+			return false;
+
+		mState->Continuations.Add(MoveTemp(continuation));
+		return true;
+	}
+
+	explicit TOceanFuture(TSharedRef<OceanAsyncPrivate::TState<T>, ESPMode::ThreadSafe> state) : mState(MoveTemp(state)) {}
+
+	TSharedRef<OceanAsyncPrivate::TState<T>, ESPMode::ThreadSafe> mState;
+};
+
+
+// Resolving side of a TOceanFuture, every promise has to be resolved exactly once
+template <typename T>
+class TOceanPromise
+{
+public:
+	TOceanPromise(FOceanCancellationToken cancellation = FOceanCancellationToken::Create())
+		: mState(MakeShared<OceanAsyncPrivate::TState<T>, ESPMode::ThreadSafe>())
+	{
+		mState->Cancellation = MoveTemp(cancellation);
+	}
+
+	TOceanFuture<T> GetFuture() const { return TOceanFuture<T>(mState); }
+
+	const FOceanCancellationToken& GetCancellationToken() const { return mState->Cancellation; }
+
+	template <typename... FArgs>
+	void SetValue(FArgs&&... args) const
+	{
+		TArray<TUniqueFunction<void(const OceanAsyncPrivate::TStored<T>&)>, TInlineAllocator<1>> continuations;
+		{
+			FScopeLock lock(&mState->Lock);
+			check(!mState->Value.IsSet());
+			mState->Value.Emplace(Forward<FArgs>(args)...);
+			continuations = MoveTemp(mState->Continuations);
+		}
+
+		// Continuations may resume coroutines that drop the last future, the promise keeps the state alive
+		for (TUniqueFunction<void(const OceanAsyncPrivate::TStored<T>&)>& continuation : continuations)
+		{
+			continuation(mState->Value.GetValue());
+		}
+	}
+
+private:
+	TSharedRef<OceanAsyncPrivate::TState<T>, ESPMode::ThreadSafe> mState;
+};
+
+
+// Resolves with every value in the order of futures once all of them have. Cancelling the result cancels those of
+// futures that have not resolved yet.
+template <typename T>
+TOceanFuture<TArray<T>> WhenAll(const TArray<TOceanFuture<T>>& futures)
+{
+	struct FJoin
+	{
+		TOceanPromise<TArray<T>> Promise;
+		TArray<T> Values;
+		std::atomic<int> Remaining { 0 };
+	};
+
+	TSharedRef<FJoin, ESPMode::ThreadSafe> join = MakeShared<FJoin, ESPMode::ThreadSafe>();
+	join->Values.SetNum(futures.Num());
+	join->Remaining = futures.Num();
+
+	TOceanFuture<TArray<T>> result = join->Promise.GetFuture();
+
+	if (futures.Num() == 0)
+	{
+		join->Promise.SetValue();
+		return result;
+	}
+
+	// Linked until each input resolves, cancelling after that has nothing left to skip
+	for (const TOceanFuture<T>& future : futures)
+	{
+		result.GetCancellationToken().Link(future.GetCancellationToken());
+	}
+
+	for (int i = 0; i < futures.Num(); i++)
+	{
+		futures[i].Then([join, i, input = futures[i].GetCancellationToken()](const T& value)
+		{
+			join->Promise.GetCancellationToken().Unlink(input);
+
+			join->Values[i] = value;
+			if (--join->Remaining == 0)
+			{
+				join->Promise.SetValue(MoveTemp(join->Values));
+			}
+		});
+	}
+
+	return result;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OceanFFT.h"
+#include "OceanFrameArena.h"
+#include "OceanHeightPyramid.h"
+#include "OceanSharedFieldPublisher.h"
+#include "OceanTextureManager.h"
+#include "OceanWorkerPool.h"
+
+
+// CPU implementation of the OceanTextureManager pipeline (spectra -> Fourier components -> 2D inverse FFT
+// -> inversion) for consumers without a GPU, e.g. dedicated servers. Every stage is split across the worker pool.
+class CUSTOMSHADERS_API OceanCPUSimulation
+{
+public:
+	struct FPruningReport
+	{
+		int N;
+		float Threshold;
+		OceanFFT::FBand Band;
+		double FullSeconds;
+		double PrunedSeconds;
+		// Height differences against the unpruned spectrum, in metres
+		float MaxHeightError;
+		float RmsHeightError;
+		float HeightRms;
+	};
+
+	static constexpr float DefaultPruningThreshold = 1e-8f;
+
+	explicit OceanCPUSimulation(OceanWorkerPool& pool = OceanWorkerPool::Get());
+
+	void SetSpectrumParameters(const OceanTextureManager::FSpectrumParameters& spectrumParameters);
+
+	// Evaluates the X, Y (height) and Z displacement fields at time. Axes outputs doesn't need are not transformed
+	// and read as zero, e.g. Height alone runs one 2D FFT instead of three.
+	void ComputeDisplacement(double time, EOceanOutputs outputs = EOceanOutputs::All);
+
+	// N x N row-major field of the last ComputeDisplacement, axis 0: X, 1: Y, 2: Z
+	TArrayView<const float> GetDisplacement(int axis) const { return mDisplacement[axis]; }
+
+	const OceanTextureManager::FSpectrumParameters& GetSpectrumParameters() const { return mSpectrumParameters; }
+
+	// When enabled, every ComputeDisplacement also rebuilds the height pyramid for ray queries
+	void SetHeightPyramidEnabled(bool enabled) { mHeightPyramidEnabled = enabled; }
+
+	// Surface of the last ComputeDisplacement with the pyramid enabled
+	const OceanHeightPyramid& GetHeightPyramid() const { return mHeightPyramid; }
+
+	// Every ComputeDisplacement also publishes its fields to publisher, written while inverting rather than copied
+	// afterwards. Null stops publishing.
+	void SetPublisher(OceanSharedFieldPublisher* publisher) { mPublisher = publisher; }
+
+	// Bins whose energy |h0(k)|^2 + |h0(-k)|^2 is below threshold times that of the strongest bin are dropped,
+	// and ComputeDisplacement only evolves and transforms the band of rows and columns around the rest.
+	// 0 keeps every bin.
+	void SetPruningThreshold(float threshold);
+
+	// Rows and columns of the spectrum holding the bins above the pruning threshold
+	const OceanFFT::FBand& GetSpectrumBand() const { return mSpectrumBand; }
+
+	// Times ComputeDisplacement of an N x N spectrum with and without pruning at threshold, compares the heights
+	// and logs the result
+	static FPruningReport MeasurePruning(int N, float threshold, int frames = 16);
+
+	// Per-frame scratch of the FFT lives here, HeapAllocations stays flat once the simulation is warm (see
+	// Ocean.CPU.CheckAllocations)
+	const OceanFrameArena::FStats& GetFrameArenaStats() const { return mFrameArena.GetStats(); }
+
+private:
+	void ComputeInitialSpectra();
+
+	void PruneSpectrum();
+
+	void ComputeFourierComponents(double time);
+
+	// Also writes axes with a non-null publishedAxes entry there
+	void Invert(float* const publishedAxes[3]);
+
+	OceanWorkerPool& mPool;
+
+	OceanTextureManager::FSpectrumParameters mSpectrumParameters;
+
+	int mRowsPerTask = 1;
+
+	TArray<FOceanComplex> mPositiveSpectrum;
+	TArray<FOceanComplex> mNegativeSpectrum;
+
+	float mPruningThreshold = DefaultPruningThreshold;
+	OceanFFT::FBand mSpectrumBand;
+
+	// w(k) / 2 pi split as in DispersionComputeShader.usf and k / |k| per bin, these only change with the
+	// spectrum parameters
+	TArray<float> mFrequencyHi;
+	TArray<float> mFrequencyLo;
+	TArray<FVector2f> mUnitWaveVector;
+
+	// Scratch of the FFT, rewound every ComputeDisplacement
+	OceanFrameArena mFrameArena;
+
+	// Only valid during ComputeDisplacement. Persistent rather than in the arena so that InitialiseOwned places
+	// every row tile next to the worker that transforms it.
+	TArray<FOceanComplex> mFourierComponents[3];
+
+	// Axes the current ComputeDisplacement transforms
+	bool mActiveAxes[3] = { true, true, true };
+	
+	TArray<float> mDisplacement[3];
+
+	bool mHeightPyramidEnabled = false;
+	OceanHeightPyramid mHeightPyramid;
+
+	OceanSharedFieldPublisher* mPublisher = nullptr;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+class OceanFrameArena;
+class OceanWorkerPool;
+
+
+struct FOceanComplex
+{
+	float Real = 0.0f;
+	float Imag = 0.0f;
+
+	constexpr FOceanComplex() = default;
+	constexpr FOceanComplex(float real, float imag) : Real(real), Imag(imag) {}
+
+	constexpr FOceanComplex operator+(const FOceanComplex& other) const { return { Real + other.Real, Imag + other.Imag }; }
+	constexpr FOceanComplex operator-(const FOceanComplex& other) const { return { Real - other.Real, Imag - other.Imag }; }
+	constexpr FOceanComplex operator*(const FOceanComplex& other) const
+	{
+		return { Real * other.Real - Imag * other.Imag, Real * other.Imag + Imag * other.Real };
+	}
+	constexpr FOceanComplex operator*(float scale) const { return { Real * scale, Imag * scale }; }
+	constexpr FOceanComplex Conjugate() const { return { Real, -Imag }; }
+	// Multiplication by i
+	constexpr FOceanComplex RotateQuarter() const { return { -Imag, Real }; }
+};
+
+
+// CPU counterpart of the butterfly/FFT compute passes: unnormalised inverse transforms (exp(+i)),
+// matching what FFTComputeShader.usf produces before InversionComputeShader.usf rescales it.
+class CUSTOMSHADERS_API OceanFFT
+{
+public:
+	// Rows and columns of an N x N field outside of which it is zero, e.g. the band of a spectrum whose high
+	// wavenumbers are negligible
+	struct FBand
+	{
+		int FirstRow = 0;
+		int NumRows = 0;
+		int FirstColumn = 0;
+		int NumColumns = 0;
+
+		static FBand Full(int N) { return { 0, N, 0, N }; }
+	};
+
+	struct FScalingSample
+	{
+		int Workers;
+		double Seconds;
+		double Speedup;
+		double Efficiency;
+	};
+
+	// exp(2 pi i k / N) for k in [0, N / 2)
+	static TArray<FOceanComplex> MakeTwiddles(int N);
+	static void MakeTwiddles(int N, TArrayView<FOceanComplex> twiddles);
+
+	// In-place inverse transform of one contiguous row, N must be a power of two
+	static void InverseRow(FOceanComplex* row, int N, const FOceanComplex* twiddles);
+
+	// InverseRow of a row that is zero outside [first, first + count), butterflies of only zero inputs are skipped
+	static void InverseRowPruned(FOceanComplex* row, int N, const FOceanComplex* twiddles, int first, int count);
+
+	// In-place 2D inverse transform of each N x N row-major field. Rows of all fields are transformed in the
+	// same pass so the pool balances across fields (e.g. the three displacement axes) as well as rows.
+	// Scratch memory comes from arena when one is given.
+	static void Inverse2D(TArrayView<FOceanComplex* const> fields, int N, OceanWorkerPool& pool, OceanFrameArena* arena = nullptr);
+
+	// Inverse2D of fields that are zero outside band. Rows outside the band are left out of the first direction
+	// entirely and both directions skip the butterflies that only see zeros.
+	static void Inverse2D(TArrayView<FOceanComplex* const> fields, int N, const FBand& band, OceanWorkerPool& pool, OceanFrameArena* arena = nullptr);
+
+	// Rows handed to one task, sized so a tile stays in L2 while leaving every worker a few tasks
+	static int GetRowsPerTask(int N, int numWorkers);
+
+	// Times Inverse2D of three N x N fields on pools of 1, 2, 4, ... up to maxWorkers threads and logs
+	// the speedup and parallel efficiency relative to one thread
+	static TArray<FScalingSample> MeasureStrongScaling(int N, int maxWorkers = 64, int iterations = 8);
+
+private:
+	static void Transpose(TArrayView<FOceanComplex* const> fields, int N, OceanWorkerPool& pool);
+};
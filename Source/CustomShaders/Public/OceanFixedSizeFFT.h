@@ -0,0 +1,232 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OceanFFT.h"
+
+
+namespace OceanFixedSizeFFTPrivate
+{
+	constexpr double Pi = 3.1415926535897932384626433832795;
+
+	// Taylor series, only ever evaluated at compile time on [0, pi / 4] where 10 terms are exact to double
+	constexpr double Sin(double x)
+	{
+		double term = x;
+		double sum = x;
+		for (int n = 1; n < 10; n++)
+		{
+			term *= -x * x / ((2 * n) * (2 * n + 1));
+			sum += term;
+		}
+		return sum;
+	}
+
+	constexpr double Cos(double x)
+	{
+		double term = 1.0;
+		double sum = 1.0;
+		for (int n = 1; n < 10; n++)
+		{
+			term *= -x * x / ((2 * n - 1) * (2 * n));
+			sum += term;
+		}
+		return sum;
+	}
+
+	constexpr int Log2(int N)
+	{
+		int log = 0;
+		while ((1 << log) < N) log++;
+		return log;
+	}
+}
+
+
+// Twiddles and bit-reversal permutation of an N point transform, built by the compiler
+template <int N>
+struct TOceanFFTTables
+{
+	static_assert(N >= 8 && (N & (N - 1)) == 0, "N must be a power of two >= 8");
+
+	static constexpr int Log2N = OceanFixedSizeFFTPrivate::Log2(N);
+
+	struct FData
+	{
+		FOceanComplex Twiddles[N / 2];
+		uint16 BitReversed[N];
+	};
+
+	static constexpr FData Make()
+	{
+		FData data {};
+
+		// Evaluate the first octant only and unfold the rest by symmetry, which keeps the
+		// compile-time cost of the larger tables low
+		for (int k = 0; k <= N / 8; k++)
+		{
+			const double angle = 2.0 * OceanFixedSizeFFTPrivate::Pi * k / N;
+			data.Twiddles[k] = FOceanComplex((float)OceanFixedSizeFFTPrivate::Cos(angle), (float)OceanFixedSizeFFTPrivate::Sin(angle));
+		}
+		for (int k = N / 8 + 1; k < N / 4; k++)
+		{
+			data.Twiddles[k] = FOceanComplex(data.Twiddles[N / 4 - k].Imag, data.Twiddles[N / 4 - k].Real);
+		}
+		for (int k = N / 4; k < N / 2; k++)
+		{
+			data.Twiddles[k] = data.Twiddles[k - N / 4].RotateQuarter();
+		}
+
+		// rev(i) is rev(i / 2) shifted down with the low bit of i moved to the top
+		data.BitReversed[0] = 0;
+		for (int i = 1; i < N; i++)
+		{
+			data.BitReversed[i] = (uint16)((data.BitReversed[i >> 1] >> 1) | ((i & 1) << (Log2N - 1)));
+		}
+
+		return data;
+	}
+
+	static constexpr FData Data = Make();
+};
+
+
+// Inverse row transform specialised for one N. The first three stages (spans 1, 2 and 4) only need the
+// twiddles 1, i and (+-1 + i) / sqrt(2) and are hard-coded; every later stage is its own instantiation
+// with compile-time span and twiddle stride.
+template <int N>
+struct TOceanFixedSizeFFT
+{
+	using FTables = TOceanFFTTables<N>;
+
+	static void InverseRow(FOceanComplex* row)
+	{
+		InverseRowPruned(row, 0, N);
+	}
+
+	// InverseRow of a row that is zero outside [first, first + count). Stages whose butterfly blocks are fewer
+	// than count wide only visit the blocks holding a non-zero input, the others would just add zeros.
+	static void InverseRowPruned(FOceanComplex* row, int first, int count)
+	{
+		if (count <= 0)
+			return;
+
+		for (int i = 0; i < N; i++)
+		{
+			const int j = FTables::Data.BitReversed[i];
+			if (i < j)
+			{
+				Swap(row[i], row[j]);
+			}
+		}
+
+		// Spans 1 and 2 fused into a radix-4 butterfly
+		ForEachBlock<4>(first, count, [row](int start)
+		{
+			const FOceanComplex a = row[start + 0] + row[start + 1];
+			const FOceanComplex b = row[start + 0] - row[start + 1];
+			const FOceanComplex c = row[start + 2] + row[start + 3];
+			const FOceanComplex d = (row[start + 2] - row[start + 3]).RotateQuarter();
+
+			row[start + 0] = a + c;
+			row[start + 2] = a - c;
+			row[start + 1] = b + d;
+			row[start + 3] = b - d;
+		});
+
+		// Span 4, twiddles exp(2 pi i k / 8)
+		ForEachBlock<8>(first, count, [row](int start)
+		{
+			constexpr float halfSqrt2 = 0.70710678118654752f;
+
+			FOceanComplex* p = row + start;
+			FOceanComplex* q = row + start + 4;
+
+			const FOceanComplex q0 = q[0];
+			const FOceanComplex q1 = FOceanComplex((q[1].Real - q[1].Imag) * halfSqrt2, (q[1].Real + q[1].Imag) * halfSqrt2);
+			const FOceanComplex q2 = q[2].RotateQuarter();
+			const FOceanComplex q3 = FOceanComplex((-q[3].Real - q[3].Imag) * halfSqrt2, (q[3].Real - q[3].Imag) * halfSqrt2);
+
+			q[0] = p[0] - q0; p[0] = p[0] + q0;
+			q[1] = p[1] - q1; p[1] = p[1] + q1;
+			q[2] = p[2] - q2; p[2] = p[2] + q2;
+			q[3] = p[3] - q3; p[3] = p[3] + q3;
+		});
+
+		if constexpr (N > 8)
+		{
+			Stage<8>(row, first, count);
+		}
+	}
+
+private:
+	// Calls body with the start of every block of BlockSize elements that holds a non-zero input. Block b
+	// gathers the inputs congruent to rev(b) modulo N / BlockSize, so consecutive inputs fall into distinct
+	// blocks until they wrap around, and the block of input i starts at rev(i mod (N / BlockSize)).
+	template <int BlockSize, typename FBody>
+	static void ForEachBlock(int first, int count, FBody&& body)
+	{
+		constexpr int numBlocks = N / BlockSize;
+
+		if (count >= numBlocks)
+		{
+			for (int start = 0; start < N; start += BlockSize)
+			{
+				body(start);
+			}
+			return;
+		}
+
+		for (int i = first; i < first + count; i++)
+		{
+			body(FTables::Data.BitReversed[i & (numBlocks - 1)]);
+		}
+	}
+
+	template <int Span>
+	static void Stage(FOceanComplex* row, int first, int count)
+	{
+		constexpr int twiddleStride = N / (2 * Span);
+
+		ForEachBlock<2 * Span>(first, count, [row](int start)
+		{
+			for (int k = 0; k < Span; k++)
+			{
+				const FOceanComplex p = row[start + k];
+				const FOceanComplex q = row[start + k + Span] * FTables::Data.Twiddles[k * twiddleStride];
+
+				row[start + k] = p + q;
+				row[start + k + Span] = p - q;
+			}
+		});
+
+		if constexpr (2 * Span < N)
+		{
+			Stage<2 * Span>(row, first, count);
+		}
+	}
+};
+
+
+// Runtime dispatch onto the specialised sizes (64 ... 2048)
+class CUSTOMSHADERS_API OceanFixedSizeFFT
+{
+public:
+	using FInverseRowFunction = void (*)(FOceanComplex* row);
+	using FInverseRowPrunedFunction = void (*)(FOceanComplex* row, int first, int count);
+
+	static constexpr int MinN = 64;
+	static constexpr int MaxN = 2048;
+
+	// nullptr if N has no specialisation
+	static FInverseRowFunction FindInverseRow(int N);
+
+	// nullptr if N has no specialisation
+	static FInverseRowPrunedFunction FindInverseRowPruned(int N);
+
+	// nullptr if N has no specialisation
+	static const uint16* FindBitReversedIndices(int N);
+
+	// Texels of the butterfly texture (see ButterflyTextureComputeShader.usf), log2(N) wide and N high,
+	// built from the compile-time tables. Returns false if N has no specialisation.
+	static bool BuildButterflyTexture(int N, TArray<FVector4f>& texels);
+};
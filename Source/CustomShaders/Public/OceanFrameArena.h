@@ -0,0 +1,71 @@
+#pragma once
+
+#include <type_traits>
+
+#include "CoreMinimal.h"
+
+
+// Linear allocator for memory that only lives for one simulation frame. Reset() rewinds it; if the previous
+// frame spilled into extra blocks they are merged into one block of the peak size, so after the first
+// frames every allocation is a pointer bump and the heap is not touched at all.
+class CUSTOMSHADERS_API OceanFrameArena
+{
+public:
+	struct FStats
+	{
+		// Blocks requested from (and returned to) the heap since construction
+		int64 HeapAllocations = 0;
+		int64 HeapFrees = 0;
+
+		// Allocations served by the arena since construction, and in the current frame
+		int64 ArenaAllocations = 0;
+		int64 FrameAllocations = 0;
+
+		int64 FrameBytes = 0;
+		int64 PeakFrameBytes = 0;
+		int64 CapacityBytes = 0;
+	};
+
+	explicit OceanFrameArena(int64 initialCapacity = 64 * 1024);
+	~OceanFrameArena();
+
+	OceanFrameArena(const OceanFrameArena&) = delete;
+	OceanFrameArena& operator=(const OceanFrameArena&) = delete;
+
+	void* Allocate(int64 size, int64 alignment = DefaultAlignment);
+
+	// Uninitialised storage for num elements, valid until the next Reset
+	template <typename T>
+	TArrayView<T> AllocateArray(int num)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "The arena never runs destructors");
+		return TArrayView<T>(static_cast<T*>(Allocate(num * (int64)sizeof(T), FMath::Max<int64>(alignof(T), DefaultAlignment))), num);
+	}
+
+	void Reset();
+
+	const FStats& GetStats() const { return mStats; }
+
+	// Cache line, also enough for any SIMD width used by the CPU simulation
+	static constexpr int64 DefaultAlignment = 64;
+
+private:
+	struct FBlock
+	{
+		uint8* Data;
+		int64 Size;
+	};
+
+	void AddBlock(int64 minimumSize);
+
+	void FreeBlocks();
+
+	// Fixed size so growing the arena never allocates bookkeeping memory
+	static constexpr int MaxBlocks = 32;
+	FBlock mBlocks[MaxBlocks];
+	int mNumBlocks = 0;
+
+	int64 mOffset = 0;
+
+	FStats mStats;
+};
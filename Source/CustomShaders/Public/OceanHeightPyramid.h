@@ -0,0 +1,86 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+class OceanWorkerPool;
+
+
+// Min/max height pyramid over a periodic displacement field, for ray queries against the displaced surface.
+//
+// Ocean space has X and Y horizontal along the field's columns and rows and Z up. Sample (x, y) of an N x N field
+// covering L x L rests at (x, y) * L / N; displacement axis 0 moves it along X, axis 2 along Y and axis 1 is its
+// height. The surface repeats every L in X and Y, and so does the pyramid.
+//
+// Level 0 holds one (min, max) per grid cell, widened by the largest horizontal displacement so the bounds stay
+// conservative after the choppy offset; each further level halves the resolution down to a single cell.
+class CUSTOMSHADERS_API OceanHeightPyramid
+{
+public:
+	struct FRay
+	{
+		FVector3f Origin = FVector3f::ZeroVector;
+		// Need not be normalised, distances are in multiples of its length
+		FVector3f Direction = FVector3f(0.0f, 0.0f, -1.0f);
+		float MaxDistance = UE_BIG_NUMBER;
+	};
+
+	struct FHit
+	{
+		bool bHit = false;
+		float Distance = 0.0f;
+		FVector3f Position = FVector3f::ZeroVector;
+	};
+
+	// Rays are traced in packets of this many lanes
+	static constexpr int PacketSize = 4;
+
+	// Copies the three N x N row-major fields and rebuilds every level
+	void Build(TArrayView<const float> displacementX, TArrayView<const float> height, TArrayView<const float> displacementY, int N, float L, OceanWorkerPool& pool);
+
+	bool IsValid() const { return mN > 0; }
+
+	// Height of the displaced surface above (x, y), the horizontal displacement is inverted by fixed-point iteration
+	float SampleHeight(float x, float y) const;
+
+	// First crossing of every ray with the displaced surface within [0, MaxDistance], from above or below.
+	// Contacts that enter and leave the surface within a quarter of a cell can be missed by grazing rays.
+	// With a pool, packets are spread over its workers.
+	void Intersect(TArrayView<const FRay> rays, TArrayView<FHit> hits, OceanWorkerPool* pool = nullptr) const;
+
+	int GetNumLevels() const { return mLevels.Num(); }
+
+	// Height range of cell (x, y) on level (N >> level cells per side), wrapped periodically
+	FVector2f GetBounds(int level, int x, int y) const;
+
+private:
+	// Advances t over cells the ray provably does not cross, returns false once t reaches tEnd. On success
+	// [t, cellExit] is the ray's span over a level 0 cell that may contain a crossing.
+	bool FindCandidate(const FRay& ray, float& t, float tEnd, float& cellExit) const;
+
+	void IntersectPacket(const FRay* rays, FHit* hits, int numRays) const;
+
+	// Height of the ray above the surface at t
+	float Evaluate(const FRay& ray, float t) const;
+
+	// Bilinear, periodic, position in cells
+	float SampleField(const TArray<float>& field, float x, float y) const;
+
+	void Dilate(int radius, OceanWorkerPool& pool);
+
+	int mN = 0;
+	float mL = 0.0f;
+	float mCellSize = 0.0f;
+	int mRowsPerTask = 1;
+
+	// Copies of the fields the pyramid was built from, so queries stay consistent while the simulation moves on
+	TArray<float> mDisplacementX;
+	TArray<float> mHeight;
+	TArray<float> mDisplacementY;
+
+	// (min, max) per cell, level l is (N >> l)^2 cells
+	TArray<TArray<FVector2f>> mLevels;
+
+	TArray<FVector2f> mScratch;
+	TArray<float> mRowMaxDisplacement;
+};
\ No newline at end of file
@@ -0,0 +1,238 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/ScopeLock.h"
+
+
+// Displacement of one simulation frame as read back to the CPU. Immutable once handed out.
+struct FOceanReadbackFrame
+{
+	// Counts submissions from 1, dropped ones included
+	uint64 Frame = 0;
+	// Simulation time of the fields
+	double Time = 0.0;
+	// Backend clock when the copy was submitted and when it was found completed, consumers can extrapolate from
+	// Time by how far they are past SubmittedAt
+	double SubmittedAt = 0.0;
+	double CompletedAt = 0.0;
+	// Smoothed CompletedAt - SubmittedAt of the ring at the time this frame completed
+	double AverageLatency = 0.0;
+	int N = 0;
+	// Axis 0: X, 1: Y / height, 2: Z, N x N row-major, empty for axes that were not read back
+	TArray<float> Axes[3];
+};
+
+
+// Reads GPU fields back to the CPU through NumSlots staging buffers without ever waiting on the GPU. Each
+// submitted frame takes the next slot; Poll picks up whichever copies have landed and publishes the newest of them,
+// older ones still landing later are dropped unread. When the GPU falls so far behind that the next slot is still in
+// flight, the submission is skipped instead of waited for.
+//
+// Submit and Poll belong to one thread (the render thread for the RHI backend), GetLatest may be called from any.
+//
+// FBackend provides FSource, FStaging and
+//   void Copy(FStaging& staging, const FSource& source), starts copying source into staging
+//   bool IsReady(FStaging& staging), true once the copy has landed, never waits
+//   void Read(FStaging& staging, FOceanReadbackFrame& frame), fills N and the axes of a landed copy
+//   double GetTime() const, clock of the timestamps in seconds
+template <typename FBackend>
+class TOceanReadbackRing
+{
+public:
+	using FSource = typename FBackend::FSource;
+	using FFramePtr = TSharedPtr<const FOceanReadbackFrame, ESPMode::ThreadSafe>;
+
+	static constexpr int DefaultNumSlots = 3;
+
+	struct FStats
+	{
+		// Copies started
+		int64 Submitted = 0;
+		// Submissions skipped because every slot was still in flight
+		int64 Dropped = 0;
+		// Landed copies that were published
+		int64 Published = 0;
+		// Landed copies not read because a newer frame landed by the same Poll or before them
+		int64 Superseded = 0;
+	};
+
+	explicit TOceanReadbackRing(int numSlots = DefaultNumSlots, FBackend backend = FBackend())
+		: mBackend(MoveTemp(backend))
+	{
+		check(numSlots > 0);
+		mSlots.SetNum(numSlots);
+	}
+
+	// False if the submission was dropped, it still takes a frame number
+	bool Submit(const FSource& source, double time)
+	{
+		mFrame++;
+
+		FSlot& slot = mSlots[mNextSlot];
+		if (slot.bInFlight)
+		{
+			mStats.Dropped++;
+			return false;
+		}
+
+		slot.bInFlight = true;
+		slot.Frame = mFrame;
+		slot.Time = time;
+		slot.SubmittedAt = mBackend.GetTime();
+		mBackend.Copy(slot.Staging, source);
+
+		mNextSlot = (mNextSlot + 1) % mSlots.Num();
+		mStats.Submitted++;
+		return true;
+	}
+
+	// True if a frame was published
+	bool Poll()
+	{
+		FSlot* newest = nullptr;
+
+		for (FSlot& slot : mSlots)
+		{
+			if (!slot.bInFlight || !mBackend.IsReady(slot.Staging))
+				continue;
+
+			slot.bInFlight = false;
+
+			if (slot.Frame <= mPublishedFrame || (newest && slot.Frame < newest->Frame))
+			{
+				mStats.Superseded++;
+				continue;
+			}
+
+			mStats.Superseded += newest ? 1 : 0;
+			newest = &slot;
+		}
+
+		if (!newest)
+			return false;
+
+		Publish(*newest);
+		return true;
+	}
+
+	// Newest published frame, null before the first one. Never waits on the producer beyond a pointer copy.
+	FFramePtr GetLatest() const
+	{
+		FScopeLock lock(&mLatestLock);
+		return mLatest;
+	}
+
+	int GetNumInFlight() const
+	{
+		int num = 0;
+		for (const FSlot& slot : mSlots)
+		{
+			num += slot.bInFlight ? 1 : 0;
+		}
+		return num;
+	}
+
+	const FStats& GetStats() const { return mStats; }
+
+	FBackend& GetBackend() { return mBackend; }
+
+private:
+	struct FSlot
+	{
+		typename FBackend::FStaging Staging;
+		bool bInFlight = false;
+		uint64 Frame = 0;
+		double Time = 0.0;
+		double SubmittedAt = 0.0;
+	};
+
+	void Publish(FSlot& slot)
+	{
+		// Frames consumers still hold are left alone, so after the first few publishes no allocation happens
+		TSharedPtr<FOceanReadbackFrame, ESPMode::ThreadSafe> frame;
+		for (const TSharedPtr<FOceanReadbackFrame, ESPMode::ThreadSafe>& candidate : mFrames)
+		{
+			if (candidate.GetSharedReferenceCount() == 1)
+			{
+				frame = candidate;
+				break;
+			}
+		}
+
+		if (!frame)
+		{
+			frame = mFrames.Add_GetRef(MakeShared<FOceanReadbackFrame, ESPMode::ThreadSafe>());
+		}
+
+		frame->Frame = slot.Frame;
+		frame->Time = slot.Time;
+		frame->SubmittedAt = slot.SubmittedAt;
+		frame->CompletedAt = mBackend.GetTime();
+		mBackend.Read(slot.Staging, *frame);
+
+		const double latency = frame->CompletedAt - frame->SubmittedAt;
+		mAverageLatency = mStats.Published > 0 ? FMath::Lerp(mAverageLatency, latency, LatencySmoothing) : latency;
+		frame->AverageLatency = mAverageLatency;
+
+		mPublishedFrame = slot.Frame;
+		mStats.Published++;
+
+		FScopeLock lock(&mLatestLock);
+		mLatest = frame;
+	}
+
+	static constexpr double LatencySmoothing = 0.1;
+
+	FBackend mBackend;
+	TArray<FSlot> mSlots;
+	int mNextSlot = 0;
+	uint64 mFrame = 0;
+	uint64 mPublishedFrame = 0;
+	double mAverageLatency = 0.0;
+	FStats mStats;
+
+	// Recycled frame storage, see Publish
+	TArray<TSharedPtr<FOceanReadbackFrame, ESPMode::ThreadSafe>> mFrames;
+
+	mutable FCriticalSection mLatestLock;
+	FFramePtr mLatest;
+};
+
+
+// Stand-in for the GPU copy engine on a simulated clock, so the ordering and latency handling of TOceanReadbackRing
+// can be checked without an RHI (see Ocean.Readback.Check). A copy lands Latency ticks after it was submitted, plus
+// up to Jitter more ticks, which lets copies land out of order.
+struct CUSTOMSHADERS_API FOceanCPUReadbackBackend
+{
+	struct FSource
+	{
+		int N = 0;
+		// N x N fields, null for axes that are not read back
+		const float* Axes[3] = {};
+	};
+
+	struct FStaging
+	{
+		int N = 0;
+		TArray<float> Axes[3];
+		uint64 ReadyAt = 0;
+	};
+
+	void Copy(FStaging& staging, const FSource& source);
+
+	bool IsReady(FStaging& staging) const { return Tick >= staging.ReadyAt; }
+
+	void Read(FStaging& staging, FOceanReadbackFrame& frame);
+
+	double GetTime() const { return Tick * TickSeconds; }
+
+	int Latency = 2;
+	int Jitter = 0;
+	double TickSeconds = 1.0 / 60.0;
+	// Advanced by the caller, one tick per simulated GPU frame
+	uint64 Tick = 0;
+
+	FRandomStream Random { 0x0CEA4 };
+	int64 CopiedBytes = 0;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+class OceanTextureManager;
+
+
+// Picks the simulation resolution per frame to hold a GPU time budget. Cost samples are smoothed, a step up is only
+// taken when the predicted cost at 2N (N^2 log N scaling) stays under the budget with headroom, and a step down as
+// soon as the smoothed cost exceeds it. The neighbouring resolutions are prewarmed one per frame so a switch never
+// has to build resources, and the manager resamples their spectra so the waves stay continuous.
+class CUSTOMSHADERS_API OceanResolutionController
+{
+public:
+	struct FSettings
+	{
+		float BudgetMs = 2.0f;
+		int MinN = 128;
+		int MaxN = 1024;
+		// Fraction of the budget the predicted cost at 2N has to fit in before stepping up
+		float UpscaleHeadroom = 0.75f;
+		// Weight of a new sample in the exponential moving average
+		float Smoothing = 0.1f;
+		// Samples ignored after a switch, GPU timings arrive a few frames late and still describe the old N
+		int SettleFrames = 8;
+		// Frames after a switch before the next decision
+		int CooldownFrames = 30;
+	};
+
+	explicit OceanResolutionController(OceanTextureManager& manager, int initialN = 512);
+
+	void SetSettings(const FSettings& settings);
+
+	// Call once per frame on the game thread with the latest simulation cost (e.g. GetLastSimulationGpuMs), negative
+	// samples are ignored. Returns the resolution to render at, which already has been applied to the manager.
+	int Update(float costMs);
+
+	int GetN() const { return mN; }
+
+	double GetSmoothedCostMs() const { return mSmoothedCostMs; }
+
+	// Cost at toN extrapolated from the cost at fromN
+	static double PredictCost(double costMs, int fromN, int toN);
+
+private:
+	void SwitchTo(int N);
+	
+	OceanTextureManager& mManager;
+	
+	FSettings mSettings;
+
+	int mN;
+
+	double mSmoothedCostMs = -1.0;
+
+	int mFramesSinceSwitch = 0;
+
+	// Neighbours of mN not yet handed to PrewarmResolution
+	bool mPrewarmUpPending = true;
+	bool mPrewarmDownPending = true;
+};
\ No newline at end of file
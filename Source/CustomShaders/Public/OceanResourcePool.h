@@ -0,0 +1,238 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PixelFormat.h"
+
+
+// What a pooled buffer of the displacement pipeline is used for
+enum class EOceanResource : uint8
+{
+	// Fourier components of an axis, also the first FFT ping-pong buffer
+	FourierComponents,
+	// Second FFT ping-pong buffer of an axis
+	PingPong,
+	// Inverted displacement of an axis whose target can't be written directly
+	Displacement,
+	Normals,
+	Foam
+};
+
+
+struct FOceanResourceKey
+{
+	int N = 0;
+	EPixelFormat Format = PF_Unknown;
+	EOceanResource Resource = EOceanResource::FourierComponents;
+	// Axis of the per-axis resources
+	int Index = 0;
+
+	bool operator==(const FOceanResourceKey& other) const
+	{
+		return N == other.N && Format == other.Format && Resource == other.Resource && Index == other.Index;
+	}
+
+	friend uint32 GetTypeHash(const FOceanResourceKey& key)
+	{
+		return HashCombine(HashCombine(::GetTypeHash(key.N), ::GetTypeHash((uint8)key.Format)), ::GetTypeHash(((uint32)key.Resource << 8) | key.Index));
+	}
+};
+
+
+// Buffers that live across frames, keyed by N, format and use. A buffer is handed out again once nobody but the pool
+// references it anymore, so a warm pipeline doesn't allocate, and a key only gets a second buffer while two requests
+// are in flight at once (e.g. one's Fourier components waiting for its FFT while the next computes its own).
+//
+// FBackend provides FResource, FTarget and
+//   FResource Allocate(const FOceanResourceKey& key)
+//   bool IsUnused(const FResource& resource), true if only the pool holds it
+//   bool CanWriteDirectly(const FTarget& target, const FOceanResourceKey& key)
+//   bool Copy(const FResource& source, const FTarget& target), false if the target doesn't fit
+template <typename FBackend>
+class TOceanResourcePool
+{
+public:
+	using FResource = typename FBackend::FResource;
+	using FTarget = typename FBackend::FTarget;
+
+	struct FStats
+	{
+		int64 Allocations = 0;
+		int64 Reuses = 0;
+		// Outputs written straight into the caller's target
+		int64 DirectWrites = 0;
+		// Outputs that went through a pooled buffer and a copy
+		int64 Copies = 0;
+	};
+
+	// Where one frame's output channels (X, Y, Z, foam and normals) are written. Channels whose target the backend
+	// can write directly use it as is, the others get a pooled buffer that FinishOutputs copies to the target.
+	struct FOutputs
+	{
+		static constexpr int NumChannels = 5;
+
+		FTarget Targets[NumChannels] {};
+		FResource Intermediates[NumChannels] {};
+		bool Direct[NumChannels] {};
+		// Second FFT ping-pong buffer of each transformed axis
+		FResource PingPong[3] {};
+	};
+
+	explicit TOceanResourcePool(FBackend backend = FBackend()) : mBackend(MoveTemp(backend)) {}
+
+	// The buffer stays reserved for as long as the returned reference is held
+	FResource Acquire(const FOceanResourceKey& key)
+	{
+		TArray<FResource>& resources = mResources.FindOrAdd(key);
+
+		for (const FResource& resource : resources)
+		{
+			if (mBackend.IsUnused(resource))
+			{
+				mStats.Reuses++;
+				return resource;
+			}
+		}
+
+		mStats.Allocations++;
+		return resources.Add_GetRef(mBackend.Allocate(key));
+	}
+
+	// Fourier components of the transformed axes (computed channels 0 to 2), which are also their first FFT
+	// ping-pong buffers. Buffers of any other N are dropped first, e.g. after a resolution switch.
+	void AcquireFourierComponents(int N, EPixelFormat format, const bool (&computed)[FOutputs::NumChannels], FResource (&components)[3])
+	{
+		if (N != mN)
+		{
+			Trim(N);
+			mN = N;
+		}
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			components[axis] = computed[axis] ? Acquire({ N, format, EOceanResource::FourierComponents, axis }) : FResource();
+		}
+	}
+
+	// Second ping-pong buffers and outputs of a frame whose Fourier components are in flight. Channels with
+	// computed[channel] unset get no storage, targets of channels with written[channel] unset are ignored. A
+	// computed channel without a target (e.g. X and Z only needed for the normals, or the normals only needed for
+	// the foam) still gets a pooled buffer.
+	FOutputs BeginOutputs(int N, EPixelFormat format, const FTarget (&targets)[FOutputs::NumChannels], const bool (&computed)[FOutputs::NumChannels], const bool (&written)[FOutputs::NumChannels])
+	{
+		FOutputs outputs;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (computed[axis])
+			{
+				outputs.PingPong[axis] = Acquire({ N, format, EOceanResource::PingPong, axis });
+			}
+		}
+
+		for (int channel = 0; channel < FOutputs::NumChannels; channel++)
+		{
+			if (!computed[channel])
+				continue;
+
+			const FOceanResourceKey key = GetOutputKey(N, format, channel);
+			outputs.Targets[channel] = written[channel] ? targets[channel] : FTarget();
+			outputs.Direct[channel] = outputs.Targets[channel] && mBackend.CanWriteDirectly(outputs.Targets[channel], key);
+
+			if (outputs.Direct[channel])
+			{
+				mStats.DirectWrites++;
+			}
+			else
+			{
+				outputs.Intermediates[channel] = Acquire(key);
+			}
+		}
+
+		return outputs;
+	}
+
+	// Copies the channels that could not be written directly to their targets
+	void FinishOutputs(const FOutputs& outputs)
+	{
+		for (int channel = 0; channel < FOutputs::NumChannels; channel++)
+		{
+			if (outputs.Targets[channel] && !outputs.Direct[channel] && outputs.Intermediates[channel])
+			{
+				mStats.Copies += mBackend.Copy(outputs.Intermediates[channel], outputs.Targets[channel]) ? 1 : 0;
+			}
+		}
+	}
+
+	// Drops every buffer not of size N, e.g. after a resolution switch
+	void Trim(int N)
+	{
+		for (auto it = mResources.CreateIterator(); it; ++it)
+		{
+			if (it.Key().N != N)
+			{
+				it.RemoveCurrent();
+			}
+		}
+	}
+
+	int Num() const
+	{
+		int num = 0;
+		for (const TPair<FOceanResourceKey, TArray<FResource>>& resources : mResources)
+		{
+			num += resources.Value.Num();
+		}
+		return num;
+	}
+
+	const FStats& GetStats() const { return mStats; }
+
+	FBackend& GetBackend() { return mBackend; }
+
+	static FOceanResourceKey GetOutputKey(int N, EPixelFormat format, int channel)
+	{
+		if (channel < 3)
+			return FOceanResourceKey { N, format, EOceanResource::Displacement, channel };
+
+		return FOceanResourceKey { N, format, channel == 3 ? EOceanResource::Foam : EOceanResource::Normals, 0 };
+	}
+
+private:
+	FBackend mBackend;
+	TMap<FOceanResourceKey, TArray<FResource>> mResources;
+	FStats mStats;
+	// N of the most recent Fourier components
+	int mN = 0;
+};
+
+
+// Plain memory stand-in for GPU textures, so the pooling and copy elimination of the displacement pipeline can be
+// checked without an RHI (see Ocean.ResourcePool.Check)
+struct CUSTOMSHADERS_API FOceanCPUResourceBackend
+{
+	struct FTexture
+	{
+		int N = 0;
+		EPixelFormat Format = PF_Unknown;
+		// Stands in for render targets created without UAV support
+		bool bWritable = true;
+		TArray<FVector4f> Texels;
+	};
+
+	using FResource = TSharedPtr<FTexture>;
+	using FTarget = FTexture*;
+
+	FResource Allocate(const FOceanResourceKey& key);
+
+	bool IsUnused(const FResource& resource) const { return resource.GetSharedReferenceCount() == 1; }
+
+	bool CanWriteDirectly(const FTarget& target, const FOceanResourceKey& key) const
+	{
+		return target->bWritable && target->N == key.N && target->Format == key.Format;
+	}
+
+	bool Copy(const FResource& source, const FTarget& target);
+
+	int64 AllocatedBytes = 0;
+	int64 CopiedBytes = 0;
+};
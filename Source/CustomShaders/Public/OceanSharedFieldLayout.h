@@ -0,0 +1,142 @@
+#pragma once
+
+// Memory layout of the displacement ring OceanSharedFieldPublisher writes into a named shared memory region.
+// Only the standard library is used, so processes outside the engine can map the region and include this as is.
+//
+// The region is a header followed by NumSlots slots. Frame f (counting from 1) goes to slot f % NumSlots; each slot
+// is a seqlock, its Sequence is odd while the producer writes it. Readers never block the producer: they read the
+// mapped fields in place and afterwards check that Sequence did not move, discarding the result otherwise.
+
+#include <atomic>
+#include <cstdint>
+
+
+namespace OceanSharedField
+{
+	// "OCNF"
+	constexpr uint32_t Magic = 0x464E434F;
+	constexpr uint32_t LayoutVersion = 1;
+	constexpr uint64_t Alignment = 64;
+	constexpr int NumAxes = 3;
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "Atomics shared between processes must be lock free");
+
+	struct alignas(Alignment) FHeader
+	{
+		// Magic is written last, a region with any other value is not initialised (yet)
+		std::atomic<uint32_t> Magic;
+		uint32_t LayoutVersion;
+		uint32_t NumSlots;
+		uint32_t MaxN;
+		uint64_t SlotStride;
+		// Newest complete frame, 0 before the first one
+		std::atomic<uint64_t> LatestFrame;
+	};
+
+	struct alignas(Alignment) FSlot
+	{
+		std::atomic<uint64_t> Sequence;
+		uint64_t Frame;
+		// Simulation time of the fields
+		double Time;
+		// FPlatformTime::Seconds() when the frame was completed, a monotonic clock shared by local processes
+		double PublishedAt;
+		int32_t N;
+		float L;
+		// Bit i is set when axis i (0: X, 1: Y / height, 2: Z) holds data, the others are stale
+		uint32_t AxisMask;
+	};
+
+	inline uint64_t AlignUp(uint64_t value)
+	{
+		return (value + Alignment - 1) & ~(Alignment - 1);
+	}
+
+	// Every axis takes MaxN * MaxN floats so the layout doesn't depend on the current N. Fields are N x N row-major.
+	inline uint64_t GetAxisStride(uint32_t maxN)
+	{
+		return AlignUp((uint64_t)maxN * maxN * sizeof(float));
+	}
+
+	inline uint64_t GetSlotStride(uint32_t maxN)
+	{
+		return AlignUp(sizeof(FSlot)) + NumAxes * GetAxisStride(maxN);
+	}
+
+	inline uint64_t GetRegionSize(uint32_t maxN, uint32_t numSlots)
+	{
+		return AlignUp(sizeof(FHeader)) + numSlots * GetSlotStride(maxN);
+	}
+
+	inline FSlot* GetSlot(FHeader* header, uint64_t frame)
+	{
+		uint8_t* slots = reinterpret_cast<uint8_t*>(header) + AlignUp(sizeof(FHeader));
+		return reinterpret_cast<FSlot*>(slots + (frame % header->NumSlots) * header->SlotStride);
+	}
+
+	inline float* GetAxis(FHeader* header, FSlot* slot, int axis)
+	{
+		return reinterpret_cast<float*>(reinterpret_cast<uint8_t*>(slot) + AlignUp(sizeof(FSlot)) + axis * GetAxisStride(header->MaxN));
+	}
+
+	inline bool IsValid(const FHeader* header)
+	{
+		return header->Magic.load(std::memory_order_acquire) == Magic && header->LayoutVersion == LayoutVersion;
+	}
+
+	// What a reader sees of one frame. Fields point into the mapped region and are only trustworthy once EndRead
+	// has returned true for this view.
+	struct FReadView
+	{
+		const FSlot* Slot = nullptr;
+		uint64_t Sequence = 0;
+		uint64_t Frame = 0;
+		double Time = 0.0;
+		double PublishedAt = 0.0;
+		int32_t N = 0;
+		float L = 0.0f;
+		uint32_t AxisMask = 0;
+		const float* Axes[NumAxes] = {};
+	};
+
+	// Starts reading the newest frame. False if there is none yet or the producer is rewriting its slot right now,
+	// in which case the caller should try again later instead of waiting.
+	inline bool BeginRead(const FHeader* header, FReadView& view)
+	{
+		FHeader* mutableHeader = const_cast<FHeader*>(header);
+
+		const uint64_t frame = header->LatestFrame.load(std::memory_order_acquire);
+		if (frame == 0)
+			return false;
+
+		FSlot* slot = GetSlot(mutableHeader, frame);
+		const uint64_t sequence = slot->Sequence.load(std::memory_order_acquire);
+		if (sequence & 1)
+			return false;
+
+		view.Slot = slot;
+		view.Sequence = sequence;
+		view.Frame = slot->Frame;
+		view.Time = slot->Time;
+		view.PublishedAt = slot->PublishedAt;
+		view.N = slot->N;
+		view.L = slot->L;
+		view.AxisMask = slot->AxisMask;
+
+		for (int axis = 0; axis < NumAxes; axis++)
+		{
+			view.Axes[axis] = GetAxis(mutableHeader, slot, axis);
+		}
+
+		return true;
+	}
+
+	// True when the slot was not touched since BeginRead, i.e. everything read through view is consistent.
+	// The producer gets NumSlots - 1 frames ahead before it reuses a slot, so reads finishing within that window
+	// always succeed.
+	inline bool EndRead(const FReadView& view)
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return view.Slot->Sequence.load(std::memory_order_relaxed) == view.Sequence;
+	}
+}
\ No newline at end of file
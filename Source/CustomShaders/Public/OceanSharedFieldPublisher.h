@@ -0,0 +1,67 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OceanSharedFieldLayout.h"
+
+
+// Publishes displacement frames to other processes on the same host through a named shared memory ring of
+// NumSlots versioned slots (see OceanSharedFieldLayout.h for the layout and the reader side). The producer never
+// waits on readers: a slot being read is simply overwritten, and the reader notices on EndRead.
+//
+// Single producer, frames are written in place between BeginFrame and EndFrame so e.g. OceanCPUSimulation can
+// invert straight into the slot instead of copying a finished field.
+class CUSTOMSHADERS_API OceanSharedFieldPublisher
+{
+public:
+	static constexpr int DefaultNumSlots = 4;
+
+	// Creates the region name, an existing one of the same name is reinitialised
+	OceanSharedFieldPublisher(const FString& name, int maxN, int numSlots = DefaultNumSlots);
+	~OceanSharedFieldPublisher();
+
+	OceanSharedFieldPublisher(const OceanSharedFieldPublisher&) = delete;
+	OceanSharedFieldPublisher& operator=(const OceanSharedFieldPublisher&) = delete;
+
+	// False if the region could not be mapped, every other call is then a no-op
+	bool IsValid() const { return mHeader != nullptr; }
+
+	int GetMaxN() const { return mMaxN; }
+
+	// Claims the next slot for an N x N frame and returns where each axis goes, null for axes not in axisMask.
+	// Readers don't see the frame before EndFrame, which has to come before the next BeginFrame.
+	void BeginFrame(double time, int N, float L, uint32 axisMask, float* axes[OceanSharedField::NumAxes]);
+
+	void EndFrame();
+
+	// BeginFrame, copy of the non-empty fields, EndFrame
+	void Publish(double time, int N, float L, TArrayView<const float> x, TArrayView<const float> y, TArrayView<const float> z);
+
+	uint64 GetLatestFrame() const { return mFrame; }
+
+private:
+	FPlatformMemory::FSharedMemoryRegion* mRegion = nullptr;
+	OceanSharedField::FHeader* mHeader = nullptr;
+	OceanSharedField::FSlot* mOpenSlot = nullptr;
+
+	int mMaxN = 0;
+	uint64 mFrame = 0;
+};
+
+
+// Read-only mapping of a region some OceanSharedFieldPublisher, possibly in another process, writes to
+class CUSTOMSHADERS_API OceanSharedFieldReader
+{
+public:
+	explicit OceanSharedFieldReader(const FString& name);
+	~OceanSharedFieldReader();
+
+	OceanSharedFieldReader(const OceanSharedFieldReader&) = delete;
+	OceanSharedFieldReader& operator=(const OceanSharedFieldReader&) = delete;
+
+	// Null if the region doesn't exist or isn't initialised, use with OceanSharedField::BeginRead / EndRead
+	const OceanSharedField::FHeader* GetHeader() const { return mHeader; }
+
+private:
+	FPlatformMemory::FSharedMemoryRegion* mRegion = nullptr;
+	const OceanSharedField::FHeader* mHeader = nullptr;
+};
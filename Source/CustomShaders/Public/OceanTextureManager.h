@@ -2,9 +2,86 @@
 
 #pragma once
 
+#include <atomic>
 #include <functional>
 
 #include "CoreMinimal.h"
+#include "OceanAsync.h"
+#include "OceanFrameArena.h"
+#include "OceanReadbackRing.h"
+#include "OceanResourcePool.h"
+#include "RenderGraphFwd.h"
+#include "RHIGPUReadback.h"
+#include "RHIResources.h"
+
+
+// Channels a ComputeDisplacement request produces. Normals are derived from the horizontal displacement and foam from
+// the normals, so either of them pulls in the X and Z transforms even without Choppiness. Normals are an output of
+// their own only through FDisplacementTargets::Normals and FDisplacementResult::Normals.
+enum class EOceanOutputs : uint8
+{
+	None = 0,
+	Height = 1 << 0,
+	// X and Z displacement
+	Choppiness = 1 << 1,
+	Normals = 1 << 2,
+	Foam = 1 << 3,
+	All = Height | Choppiness | Normals | Foam
+};
+ENUM_CLASS_FLAGS(EOceanOutputs);
+
+
+// Render thread side of the displacement pipeline's TOceanResourcePool. Targets with UAV support and of the right
+// size and format are written directly, everything else gets a pooled texture copied out afterwards. The textures
+// are created outside GRenderTargetPool, so the resource pool's reference is the only one once a request lets go.
+struct FOceanRHIResourceBackend
+{
+	using FResource = TRefCountPtr<IPooledRenderTarget>;
+	using FTarget = UTextureRenderTarget2D*;
+
+	FResource Allocate(const FOceanResourceKey& key);
+
+	bool IsUnused(const FResource& resource) const { return resource->GetRefCount() == 1; }
+
+	bool CanWriteDirectly(const FTarget& target, const FOceanResourceKey& key) const;
+
+	bool Copy(const FResource& source, const FTarget& target);
+
+	// Set around FinishOutputs, Copy records onto it
+	FRHICommandListImmediate* CommandList = nullptr;
+};
+
+
+// Render thread side of the displacement readback ring, one GPU readback with its own fence per axis and slot
+struct FOceanRHIReadbackBackend
+{
+	struct FSource
+	{
+		// Null for axes that are not read back
+		FRHITexture* Axes[3] = {};
+	};
+
+	struct FStaging
+	{
+		TUniquePtr<FRHIGPUTextureReadback> Readbacks[3];
+		bool bCopied[3] = {};
+		int N = 0;
+	};
+
+	void Copy(FStaging& staging, const FSource& source);
+
+	bool IsReady(FStaging& staging) const;
+
+	void Read(FStaging& staging, FOceanReadbackFrame& frame);
+
+	double GetTime() const { return FPlatformTime::Seconds(); }
+
+	// Set around Submit, Copy records onto it
+	FRHICommandListImmediate* CommandList = nullptr;
+};
+
+
+class OceanSharedFieldPublisher;
 
 
 class CUSTOMSHADERS_API OceanTextureManager
@@ -23,6 +100,41 @@ public:
 		FVector2f WindDirection = FVector2f(1.0f, 1.0f);
 		float WindSpeed = 20;
 	};
+
+	// Caller owned outputs of a displacement request, each may be null. N x N float RGBA targets with UAV support are
+	// written directly by the simulation, any others are copied into.
+	struct FDisplacementTargets
+	{
+		UTextureRenderTarget2D* X = nullptr;
+		UTextureRenderTarget2D* Y = nullptr;
+		UTextureRenderTarget2D* Z = nullptr;
+		UTextureRenderTarget2D* Foam = nullptr;
+		UTextureRenderTarget2D* Normals = nullptr;
+	};
+
+	struct FDisplacementResult
+	{
+		double Time = 0.0;
+		// The request was superseded or cancelled before it reached the GPU, the textures are null
+		bool bCancelled = false;
+		// Render thread textures of the channels the request produced, axis 0: X, 1: Y, 2: Z. Either the target itself,
+		// when it could be written directly, or a pooled buffer that is not reused while referenced here.
+		TRefCountPtr<IPooledRenderTarget> Displacement[3];
+		TRefCountPtr<IPooledRenderTarget> Foam;
+		TRefCountPtr<IPooledRenderTarget> Normals;
+	};
+
+	// Incremental time evolution: exp(iwt) is kept in a texture and advanced by exp(iw*TimeStep)
+	// per step instead of being re-evaluated per bin every frame
+	struct FPhasorEvolutionParameters
+	{
+		bool bEnabled = false;
+		float TimeStep = 1.0f / 60.0f;
+		// Steps after which the phasors are rebuilt from the double precision time base
+		int RenormalizeInterval = 240;
+		// Larger time jumps reseed instead of stepping
+		int MaxStepsPerFrame = 4;
+	};
 	
 	static OceanTextureManager* Get()
 	{
@@ -30,8 +142,12 @@ public:
 		return mSingleton;
 	}
 
+	// Applied on the render thread from the next command on. N becomes the active resolution until the next
+	// SetResolution.
 	void SetSpectrumParameters(const FSpectrumParameters& spectrumParameters);
 
+	void SetPhasorEvolutionParameters(const FPhasorEvolutionParameters& phasorParameters);
+
 	DECLARE_DELEGATE_OneParam(FOnButterflyTextureReady, TRefCountPtr<IPooledRenderTarget> butterflyTexture);
 	void ComputeButterfly(FOnButterflyTextureReady onComplete);
 	
@@ -39,23 +155,204 @@ public:
 	void ComputeInitialSpectra(FOnInitialSpectraTexturesReady onComplete, bool useCache = true);
 	
 	DECLARE_DELEGATE_OneParam(FOnFourierComponentsReady, FFourierComponents fourierComponentsTexture);
-	void ComputeFourierComponents(float time, FOnFourierComponentsReady onComplete);
+	void ComputeFourierComponents(double time, FOnFourierComponentsReady onComplete, EOceanOutputs outputs = EOceanOutputs::All, FOceanCancellationToken cancellation = FOceanCancellationToken());
 	
 	DECLARE_DELEGATE_OneParam(FOnDisplacementFieldReady, TRefCountPtr<IPooledRenderTarget> fourierComponentsTexture);
-	void ComputeDisplacement(float time, FOnDisplacementFieldReady onComplete, UTextureRenderTarget2D* displacementOutX, UTextureRenderTarget2D* displacementOutY, UTextureRenderTarget2D* displacementOutZ, UTextureRenderTarget2D* foamOutTarget);
+	// Only the channels in outputs are generated, transformed and copied out; targets of the others may be null.
+	// Height alone runs one of the three FFTs and skips normals and foam.
+	void ComputeDisplacement(double time, FOnDisplacementFieldReady onComplete, UTextureRenderTarget2D* displacementOutX, UTextureRenderTarget2D* displacementOutY, UTextureRenderTarget2D* displacementOutZ, UTextureRenderTarget2D* foamOutTarget, EOceanOutputs outputs = EOceanOutputs::All);
+
+	// Awaitable ComputeDisplacement, e.g. co_await Displacement(t) in a coroutine returning TOceanFuture. Each
+	// request supersedes the previous one of the same channel: unless that one already reached the GPU it is
+	// dropped and resolves as cancelled, so stale frames stop consuming GPU time. Game thread only.
+	TOceanFuture<FDisplacementResult> Displacement(double time, const FDisplacementTargets& targets = FDisplacementTargets(), EOceanOutputs outputs = EOceanOutputs::All, int channel = 0);
+
+	// Whether displacement axis (0: X, 1: Y, 2: Z) has to be transformed to produce outputs
+	static bool NeedsDisplacementAxis(EOceanOutputs outputs, int axis);
+
+	// Channels (X, Y, Z, foam, normals) a request for outputs computes, and those of them written to their target.
+	// X and Z may only be computed for the normals and the normals only for the foam, they are not written then.
+	static void GetDisplacementChannels(EOceanOutputs outputs, bool (&computed)[5], bool (&written)[5]);
+
+	// Splits t into a 12 significant bit head and a float tail, see PhasorComputeShader.usf
+	static void SplitTime(double time, float& timeHi, float& timeLo);
+
+	// Evaluates the displacement at every time in one graph, sharing spectra, butterflies and dispersion and
+	// transforming all timesteps in the same FFT dispatches. Slice 3 * i + axis of the array holds X/Y/Z at times[i].
+	DECLARE_DELEGATE_OneParam(FOnDisplacementBatchReady, TRefCountPtr<IPooledRenderTarget> displacementArray);
+	// Batches above GetMaxDisplacementBatchSize() exceed the RHI's array slice limit, they are rejected with an error
+	// and complete with a null texture.
+	void ComputeDisplacementBatch(const TArray<double>& times, FOnDisplacementBatchReady onComplete);
+
+	// Most times one ComputeDisplacementBatch can take. Ocean.DisplacementBatch.Measure compares its throughput
+	// against separate ComputeDisplacement calls.
+	static int GetMaxDisplacementBatchSize();
+
+	// Render thread only
+	const OceanFrameArena::FStats& GetRenderArenaStats() const { return mRenderArena.GetStats(); }
+
+	// Render thread only. Every GPU transient of a displacement request comes from this pool, so Allocations stays
+	// flat once the request mix is warm (see Ocean.Displacement.CheckAllocations).
+	const TOceanResourcePool<FOceanRHIResourceBackend>::FStats& GetResourcePoolStats() const { return mResourcePool.GetStats(); }
+
+	// Game thread only, requests in flight or waiting to be reused
+	int GetNumDisplacementRequests() const { return mDisplacementRequestPool.Num(); }
+
+	// Builds the butterfly texture, dispersion table and initial spectra for N in the background. The spectra are
+	// resampled from the active resolution: shared wave vectors keep their amplitude and phase, so switching only
+	// adds or removes the finest waves.
+	void PrewarmResolution(int N);
+
+	// Switches N for every command enqueued after this call, prewarming it first if needed. The output render
+	// targets have to be resized to N x N by the caller; frames with mismatched targets are not copied.
+	void SetResolution(int N);
+
+	// True once a PrewarmResolution(N) has completed on the render thread
+	bool IsResolutionWarm(int N) const;
+
+	// From now on the displacement of every ComputeDisplacement is read back to the CPU for the given channels
+	// (Height: Y, Choppiness: X and Z) as far as the request produced them, None stops it. Nothing waits on the GPU,
+	// landed copies are picked up at the end of every render thread frame, so readbacks trail the simulation by a few
+	// frames.
+	void SetReadbackOutputs(EOceanOutputs outputs);
+
+	// Newest displacement read back, null before the first one. Any thread.
+	TOceanReadbackRing<FOceanRHIReadbackBackend>::FFramePtr GetLatestReadback() const { return mReadback.GetLatest(); }
+
+	// Every frame read back (see SetReadbackOutputs) is also published to publisher, with the L of the current spectrum
+	// parameters. The render thread becomes the publisher's producer, so nothing else may publish to it meanwhile.
+	// Null stops publishing.
+	void SetSharedFieldPublisher(OceanSharedFieldPublisher* publisher);
+
+	// GPU time of the most recently completed ComputeDisplacement in milliseconds, negative until one is known.
+	// Results lag a few frames behind since they are collected without waiting on the GPU.
+	float GetLastSimulationGpuMs() const { return mLastSimulationGpuMs.load(); }
 
 private:
-	OceanTextureManager() = default;
+	OceanTextureManager();
 	
+	struct FPhasorState
+	{
+		TRefCountPtr<IPooledRenderTarget> Phasors;
+		int N = 0;
+		double Time = 0.0;
+		int StepsSinceReseed = 0;
+	};
+
+	struct FInitialSpectra
+	{
+		TRefCountPtr<IPooledRenderTarget> Positive;
+		TRefCountPtr<IPooledRenderTarget> Negative;
+		// Relative to a spectrum computed directly at its N, see BuildInitialSpectra_RenderThread
+		float Scale = 1.0f;
+	};
+
+	struct FDisplacementRequest
+	{
+		double Time = 0.0;
+		EOceanOutputs Outputs = EOceanOutputs::All;
+		FDisplacementTargets Targets;
+		FOceanCancellationToken Cancellation;
+		FPhasorEvolutionParameters PhasorParameters;
+		// Promise of a Displacement call, otherwise the delegate of a ComputeDisplacement call
+		TOptional<TOceanPromise<FDisplacementResult>> Promise;
+		FOnDisplacementFieldReady OnDisplacementFieldReady;
+
+		// Called once, on the render thread unless there was nothing to produce
+		void Complete(const FDisplacementResult& result);
+	};
+
+	struct FPendingTiming
+	{
+		FRHIPooledRenderQuery Begin;
+		FRHIPooledRenderQuery End;
+	};
+
+	// Render thread only, N is superseded by mN
 	FSpectrumParameters mSpectrumParameters;
+
+	// Render thread only, active resolution set by SetSpectrumParameters or SetResolution
+	int mN = FSpectrumParameters().N;
+
+	FPhasorEvolutionParameters mPhasorParameters;
 	
+	// Render thread only
 	TMap<int, TRefCountPtr<IPooledRenderTarget>> mButterflyTextureCache;
 	
-	TMap<int, std::pair<TRefCountPtr<IPooledRenderTarget>, TRefCountPtr<IPooledRenderTarget>>> mInitialSpectraCache;
+	// Render thread only
+	TMap<int, FInitialSpectra> mInitialSpectraCache;
+
+	// Bit log2(N) is set once N has been prewarmed
+	std::atomic<uint32> mWarmResolutions { 0 };
 	
-	static TArray<int> PrecomputeBitReversedIndices(int N);
+	// Render thread only
+	TMap<int, TRefCountPtr<IPooledRenderTarget>> mDispersionCache;
+
+	// Render thread only
+	FPhasorState mPhasorState;
+
+	// Game thread only, most recent Displacement request of each channel
+	TMap<int, FOceanCancellationToken> mDisplacementChannels;
+
+	// Game thread only, requests are reused once the render thread has let go of them
+	TArray<TSharedRef<FDisplacementRequest>> mDisplacementRequestPool;
+
+	// Render thread only, scratch for data uploaded by a single command
+	OceanFrameArena mRenderArena;
+
+	// Render thread only, Fourier components, FFT buffers and outputs of the displacement requests, trimmed when N
+	// changes
+	TOceanResourcePool<FOceanRHIResourceBackend> mResourcePool;
+
+	// Render thread only, apart from GetLatest
+	TOceanReadbackRing<FOceanRHIReadbackBackend> mReadback;
+	EOceanOutputs mReadbackOutputs = EOceanOutputs::None;
+
+	// Render thread only
+	OceanSharedFieldPublisher* mSharedFieldPublisher = nullptr;
+
+	// Render thread only, timestamps around ComputeDisplacement
+	FRenderQueryPoolRHIRef mTimestampQueryPool;
+	FRHIPooledRenderQuery mOpenTimestamp;
+	static constexpr int MaxPendingTimings = 4;
+	FPendingTiming mPendingTimings[MaxPendingTimings];
+	int mFirstPendingTiming = 0;
+	int mNumPendingTimings = 0;
 	
-	static OceanTextureManager* mSingleton;
+	std::atomic<float> mLastSimulationGpuMs { -1.0f };
+
+	TRefCountPtr<IPooledRenderTarget> GetButterflyTexture_RenderThread(FRHICommandListImmediate& rhiCmdList, int N);
+
+	// Computes the spectra for N from the current parameters and caches them. With sourceN cached, the wave
+	// vectors both sizes share are taken from it instead of the new noise.
+	const FInitialSpectra& BuildInitialSpectra_RenderThread(FRHICommandListImmediate& rhiCmdList, int N, int sourceN = 0);
 
-	static TRefCountPtr<IPooledRenderTarget> mLastFoamTexture;
+	void BeginSimulationTiming_RenderThread(FRHICommandListImmediate& rhiCmdList);
+	void EndSimulationTiming_RenderThread(FRHICommandListImmediate& rhiCmdList);
+
+	const TSharedRef<FDisplacementRequest>& AcquireDisplacementRequest();
+
+	void EnqueueDisplacement(const TSharedRef<FDisplacementRequest>& request);
+
+	// Publishes landed readbacks, also to mSharedFieldPublisher
+	void PollReadback_RenderThread(FRHICommandListImmediate& rhiCmdList);
+
+	// Bound to FCoreDelegates::OnEndFrameRT, polls the readbacks whether or not anything was submitted this frame
+	void OnEndFrame_RenderThread();
+
+	// Fourier components, FFT, normals, foam and output copies of one request
+	void ComputeDisplacement_RenderThread(FRHICommandListImmediate& rhiCmdList, FDisplacementRequest& request);
+
+	// Outputs nothing for the axes outputs doesn't need
+	FFourierComponents ComputeFourierComponents_RenderThread(FRHICommandListImmediate& rhiCmdList, double time, EOceanOutputs outputs, const FPhasorEvolutionParameters& phasorParameters);
+
+	// Cached spectra for N, built if there are none yet
+	const FInitialSpectra& GetInitialSpectra_RenderThread(FRHICommandListImmediate& rhiCmdList, int N);
+
+	// Dispersion table for N, computed once per spectrum parameter set
+	FRDGTextureRef RegisterDispersionTexture(FRDGBuilder& rdgBuilder, int N);
+	
+	static void PrecomputeBitReversedIndices(int N, TArrayView<int> reversedIndices);
+	
+	static OceanTextureManager* mSingleton;
 };
\ No newline at end of file
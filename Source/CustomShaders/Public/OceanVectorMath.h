@@ -0,0 +1,93 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OceanFFT.h"
+
+
+// Vectorised float transcendentals (sin/cos, log, sqrt) and the per-bin spectrum kernels of the CPU simulation
+// built on them. Every entry point processes a whole array and dispatches once per call to the widest instruction
+// set the CPU and OS support. The Scalar set runs the libm based reference the vector ones are checked against.
+class CUSTOMSHADERS_API OceanVectorMath
+{
+public:
+	enum class EIsa : uint8
+	{
+		Scalar,
+		SSE4,
+		// AVX2 + FMA
+		AVX2,
+		// AVX-512F
+		AVX512
+	};
+
+	struct FAccuracyReport
+	{
+		EIsa Isa;
+		// Against double precision std:: results rounded to float
+		float SinCosMaxUlp;
+		float SinCosTurnsMaxUlp;
+		float LogMaxUlp;
+		float SqrtMaxUlp;
+		// sin/cos over the whole documented SinCos range, where the ulp of results near zero is meaningless
+		float SinCosMaxAbsError;
+		// Largest component difference of EvolveSpectrum against the Scalar set relative to the largest height
+		float EvolveSpectrumMaxRelativeError;
+		float EvolveSpectrumNsPerBin;
+	};
+
+	// The bins of a spectrum, see OceanCPUSimulation
+	struct FSpectrumBins
+	{
+		const FOceanComplex* Positive;
+		const FOceanComplex* Negative;
+		// Frequency in cycles per second split into a 12 significant bit head and the rest, as in
+		// DispersionComputeShader.usf
+		const float* FrequencyHi;
+		const float* FrequencyLo;
+		const FVector2f* UnitWaveVector;
+	};
+
+	// Widest instruction set usable on this machine
+	static EIsa GetSupportedIsa();
+
+	// Instruction set the kernels run with, GetSupportedIsa() unless overridden
+	static EIsa GetIsa();
+
+	// Forces a narrower instruction set, clamped to GetSupportedIsa(). Not safe while kernels are running.
+	static void SetIsa(EIsa isa);
+
+	static const TCHAR* GetIsaName(EIsa isa);
+
+	// Keeps 12 significant bits in frequencyHi so frequencyHi * timeHi is exact, see DispersionComputeShader.usf
+	static void SplitFrequency(float frequency, float& frequencyHi, float& frequencyLo);
+
+	// sin and cos of x radians. Range reduction is exact for |x| < 4e5, beyond that results are undefined.
+	static void SinCos(const float* x, float* sinOut, float* cosOut, int count);
+
+	// sin and cos of 2 pi turns for any finite turns
+	static void SinCosTurns(const float* turns, float* sinOut, float* cosOut, int count);
+
+	// Natural log of positive normal x
+	static void Log(const float* x, float* out, int count);
+
+	static void Sqrt(const float* x, float* out, int count);
+
+	// NoiseComputeShader.usf hash at (firstX + i, y) for i in [0, count)
+	static void NoiseRow(float firstX, float y, float* out, int count);
+
+	// gaussRND (InitialSpectraComputeShader.usf): sqrt(-2 log u1) exp(2 pi i u0), uniforms clamped to [0.001, 1]
+	static void GaussRandom(const float* uniform0, const float* uniform1, FOceanComplex* out, int count);
+
+	// h(k, t) = h0(k) exp(iwt) + conj(h0(-k)) exp(-iwt) of count bins into outY and -i k / |k| h into outX and outZ.
+	// t is given as OceanTextureManager::SplitTime parts so the phase stays exact for long uptimes. Null outputs
+	// are skipped.
+	static void EvolveSpectrum(const FSpectrumBins& bins, float timeHi, float timeLo, FOceanComplex* outX, FOceanComplex* outY, FOceanComplex* outZ, int count);
+
+	// Runs every kernel of isa on samples random inputs, compares them against the references and logs the result
+	static FAccuracyReport CheckAgainstReference(EIsa isa, int samples = 1 << 16);
+
+	// Bounds CheckAgainstReference results are held to, instruction sets exceeding them fall back to Scalar
+	static constexpr float MaxUlp = 2.0f;
+	static constexpr float MaxSinCosAbsError = 1e-6f;
+	static constexpr float MaxEvolveSpectrumRelativeError = 1e-5f;
+};
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+
+
+class FEvent;
+class FRunnableThread;
+
+
+// Persistent fork-join pool for the CPU simulation. Worker w is pinned to one physical core (all of its SMT
+// siblings, cores ordered by NUMA node) and always runs row tiles w, w + NumWorkers, ... so a given row tile is
+// always touched by the same core, which together with first-touch initialisation (see InitialiseOwned) keeps
+// buffers on the owner's NUMA node. The calling thread only waits, every task runs on a pinned worker.
+//
+// One job at a time: concurrent callers are serialised, a nested call from inside a task is a fatal error.
+class CUSTOMSHADERS_API OceanWorkerPool
+{
+public:
+	// Physical core of the machine, as far as the platform reports its topology
+	struct FCore
+	{
+		// Logical processors of the core (only the first 64 can be addressed)
+		uint64 AffinityMask = 0;
+		int Node = 0;
+	};
+
+	// Workers beyond the number of physical cores share cores round-robin
+	explicit OceanWorkerPool(int numWorkers);
+	~OceanWorkerPool();
+
+	OceanWorkerPool(const OceanWorkerPool&) = delete;
+	OceanWorkerPool& operator=(const OceanWorkerPool&) = delete;
+
+	// Shared pool sized to the physical core count, at most MaxWorkers
+	static OceanWorkerPool& Get();
+
+	int GetNumWorkers() const { return mWorkers.Num(); }
+
+	// Runs body(task) for every task in [0, numTasks) and returns once all of them finished. Tasks come in
+	// consecutive runs of tasksPerField (e.g. the row tiles of several fields, 0 for a single run); tile r of every
+	// run goes to worker r % NumWorkers, the one InitialiseOwned has first touch its rows.
+	void ParallelFor(int numTasks, TFunctionRef<void(int task)> body, int tasksPerField = 0);
+
+	// Physical cores ordered by NUMA node, one logical processor per entry if the topology is unknown
+	static TArray<FCore> QueryPhysicalCores();
+
+	// Zero-fills buffer with the same task -> worker mapping as ParallelFor over rows of rowSize elements,
+	// so that pages are first touched by the worker that will process them
+	template <typename T>
+	void InitialiseOwned(TArray<T>& buffer, int numElements, int rowSize, int rowsPerTask)
+	{
+		buffer.SetNumUninitialized(numElements);
+
+		const int rows = numElements / rowSize;
+		ParallelFor(FMath::DivideAndRoundUp(rows, rowsPerTask), [&](int task)
+		{
+			const int firstRow = task * rowsPerTask;
+			const int lastRow = FMath::Min(firstRow + rowsPerTask, rows);
+			FMemory::Memzero(buffer.GetData() + firstRow * rowSize, (lastRow - firstRow) * rowSize * sizeof(T));
+		});
+	}
+
+	static constexpr int MaxWorkers = 64;
+
+private:
+	class FWorker;
+
+	void RunTasks(int workerIndex);
+
+	TArray<FWorker*> mWorkers;
+
+	// Held for the whole of ParallelFor
+	FCriticalSection mJobLock;
+
+	// Current job, only valid while ParallelFor is running
+	const TFunctionRef<void(int)>* mBody = nullptr;
+	int mNumTasks = 0;
+	int mTasksPerField = 0;
+	std::atomic<int> mPendingWorkers { 0 };
+	FEvent* mDoneEvent = nullptr;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DataDrivenShaderPlatformInfo.h"
+#include "ShaderParameterStruct.h"
+#include "GlobalShader.h"
+
+#define NUM_THREADS_PER_GROUP_DIMENSION 32
+
+
+struct FPhasorComputeShader : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FPhasorComputeShader);
+
+	SHADER_USE_PARAMETER_STRUCT(FPhasorComputeShader, FGlobalShader);
+	
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<FVector4>, Dispersion)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<FVector4>, Phasors)
+		SHADER_PARAMETER(float, TimeHi)
+		SHADER_PARAMETER(float, TimeLo)
+		SHADER_PARAMETER(float, TimeStep)
+		SHADER_PARAMETER(int, Steps)
+		SHADER_PARAMETER(int, Reseed)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+
+	static inline void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+		OutEnvironment.SetDefine(TEXT("THREADGROUPSIZE_X"), NUM_THREADS_PER_GROUP_DIMENSION);
+		OutEnvironment.SetDefine(TEXT("THREADGROUPSIZE_Y"), NUM_THREADS_PER_GROUP_DIMENSION);
+		OutEnvironment.SetDefine(TEXT("THREADGROUPSIZE_Z"), 1);
+	}
+};
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include "ButterflyTextureComputeShader.h"
 #include "OceanTextureManager.h"
 #include "Kismet/GameplayStatics.h"
+#include "Engine/TextureRenderTarget2D.h"
 
 
 // Sets default values
@@ -20,7 +21,15 @@ AComputeTester::AComputeTester()
 void AComputeTester::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	OceanTextureManager::FPhasorEvolutionParameters phasorParameters;
+	phasorParameters.bEnabled = IncrementalTimeEvolution;
+	phasorParameters.TimeStep = TimeStep;
+
+	OceanTextureManager::Get()->SetPhasorEvolutionParameters(phasorParameters);
+
+	ResolutionController = MakeUnique<OceanResolutionController>(*OceanTextureManager::Get());
+	ApplyResolutionSettings();
 }
 
 // Called every frame
@@ -37,6 +46,38 @@ void AComputeTester::Tick(float DeltaTime)
 	{
 
 	}
+
+	if (AdaptiveResolution && ResolutionController)
+	{
+		const int lastN = ResolutionController->GetN();
+		const int N = ResolutionController->Update(OceanTextureManager::Get()->GetLastSimulationGpuMs());
+
+		if (N != lastN) ResizeTargets(N);
+	}
+}
+
+void AComputeTester::ApplyResolutionSettings()
+{
+	if (!AdaptiveResolution || !ResolutionController)
+		return;
+	
+	OceanResolutionController::FSettings settings;
+	settings.BudgetMs = ResolutionBudgetMs;
+	settings.MinN = FMath::RoundUpToPowerOfTwo(FMath::Max(MinResolution, 64));
+	settings.MaxN = FMath::Max<int>(settings.MinN, FMath::RoundUpToPowerOfTwo(MaxResolution));
+
+	// The bounds may force a switch right away
+	const int lastN = ResolutionController->GetN();
+	ResolutionController->SetSettings(settings);
+	if (ResolutionController->GetN() != lastN) ResizeTargets(ResolutionController->GetN());
+}
+
+void AComputeTester::ResizeTargets(int N)
+{
+	for (UTextureRenderTarget2D* target : { X, Y, Z, Foam })
+	{
+		if (target) target->ResizeTarget(N, N);
+	}
 }
 
 void AComputeTester::Fire(UTextureRenderTarget2D* t)
@@ -45,7 +86,9 @@ void AComputeTester::Fire(UTextureRenderTarget2D* t)
 	//OceanComputeShaderDispatcher::Get()->ComputeFourierComponents(256, Target);
 
 	GEngine->AddOnScreenDebugMessage(INDEX_NONE, 10.f, FColor::Red, FString::FromInt(FDateTime::Now().GetMillisecond() / 1000.f));
-	OceanTextureManager::Get()->ComputeDisplacement(UGameplayStatics::GetRealTimeSeconds(GetWorld()) + 10000.f, OceanTextureManager::FOnDisplacementFieldReady(), X, Y, Z, Foam);
+	// A frame the render thread hasn't started yet when the next one is fired is dropped rather than rendered late
+	OceanTextureManager::Get()->Displacement(GetWorld()->GetRealTimeSeconds() + 10000.0, { X, Y, Z, Foam },
+		HeightOnly ? EOceanOutputs::Height : EOceanOutputs::All);
 }
 
 
@@ -56,10 +99,19 @@ void AComputeTester::PostEditChangeProperty(struct FPropertyChangedEvent& Proper
 	GEngine->AddOnScreenDebugMessage(INDEX_NONE, 10.f, FColor::Red, "Recalculating initial spectra");
                                          		
     OceanTextureManager::FSpectrumParameters spectrumParameters;
+    if (AdaptiveResolution && ResolutionController) spectrumParameters.N = ResolutionController->GetN();
     spectrumParameters.A = A;
     spectrumParameters.L = L;
     spectrumParameters.WindDirection = WindDirection;
     spectrumParameters.WindSpeed = WindSpeed;
 
     OceanTextureManager::Get()->SetSpectrumParameters(spectrumParameters);
+
+    OceanTextureManager::FPhasorEvolutionParameters phasorParameters;
+    phasorParameters.bEnabled = IncrementalTimeEvolution;
+    phasorParameters.TimeStep = TimeStep;
+
+    OceanTextureManager::Get()->SetPhasorEvolutionParameters(phasorParameters);
+
+    ApplyResolutionSettings();
 }
\ No newline at end of file
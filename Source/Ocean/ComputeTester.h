@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "OceanResolutionController.h"
 #include "ComputeTester.generated.h"
 
 UCLASS()
@@ -51,4 +52,33 @@ public:
 
 	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Ocean)
 	float WindSpeed = 40.f;
+
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Ocean)
+	bool IncrementalTimeEvolution = false;
+
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Ocean)
+	float TimeStep = 1.0f / 60.0f;
+
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Ocean)
+	bool AdaptiveResolution = false;
+
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Ocean)
+	float ResolutionBudgetMs = 2.0f;
+
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Ocean)
+	int32 MinResolution = 128;
+
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Ocean)
+	int32 MaxResolution = 1024;
+
+	// Only Y is simulated and written, X, Z and Foam keep their last contents
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Ocean)
+	bool HeightOnly = false;
+
+private:
+	void ApplyResolutionSettings();
+
+	void ResizeTargets(int N);
+	
+	TUniquePtr<OceanResolutionController> ResolutionController;
 };